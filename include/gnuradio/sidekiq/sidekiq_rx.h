@@ -11,6 +11,7 @@
 #include <pmt/pmt.h>
 #include <gnuradio/sidekiq/api.h>
 #include <gnuradio/sync_block.h>
+#include <vector>
 
 using pmt::pmt_t;
 
@@ -34,7 +35,16 @@ public:
           int trigger_src,
           int pps_source,
           int cal_mode,
-          int cal_type
+          int cal_type,
+          int capture_blocks = 0,
+          int output_format = 0,
+          int rx_strategy = 1,
+          int stream_mode = 0,
+          int packed_mode = 0,
+          int overrun_mode = 0,
+          int port3_handle = 100,
+          int port4_handle = 100,
+          const std::vector<int> &extra_cards = std::vector<int>()
           );
 
             virtual void set_rx_sample_rate(double value) = 0;
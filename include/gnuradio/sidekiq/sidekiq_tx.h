@@ -11,6 +11,7 @@
 #include <pmt/pmt.h>
 #include <gnuradio/sidekiq/api.h>
 #include <gnuradio/sync_block.h>
+#include <vector>
 
 using pmt::pmt_t;
 
@@ -32,7 +33,16 @@ public:
                         std::string burst_tag,
                         int threads,
                         int buffer_size,
-                        int cal_mode);
+                        int cal_mode,
+                        int packed_mode = 0,
+                        int queue_depth = 20,
+                        int timestamp_mode = 0,
+                        int burst_mode = 0,
+                        int latency_mode = 0,
+                        int handle2 = 100,
+                        int input_format = 0,
+                        int cyclic_mode = 0,
+                        std::string cyclic_file = "");
 
             virtual void set_tx_sample_rate(double value) = 0;
 
@@ -46,6 +56,9 @@ public:
 
             virtual void run_tx_cal(int value) = 0;
 
+            /* waveform repeated in cyclic mode, replaces the current one at the end of its cycle */
+            virtual void set_cyclic_waveform(const std::vector<gr_complex> &waveform) = 0;
+
 
 };
 
@@ -0,0 +1,68 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Prints the TX conversion rate of each fused scale/saturate/convert kernel next to the two
+ * pass volk path it replaced, a multiply into a float buffer then a convert.  Not run by
+ * ctest, the numbers depend on the machine.
+ */
+
+#include "iq_convert.h"
+#include <gnuradio/gr_complex.h>
+#include <volk/volk.h>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace gr::sidekiq;
+
+static const uint32_t num_blocks = 20000;
+
+template <typename F>
+static double msamples_per_second(uint32_t block_samples, F &&run)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < num_blocks; i++)
+    {
+        run();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return (static_cast<double>(block_samples) * num_blocks) / seconds / 1e6;
+}
+
+int main()
+{
+    const uint32_t block_samples = 1020;
+    const float dac_scaling = 2047.0f;
+    std::vector<gr_complex> in(block_samples);
+    std::vector<gr_complex> temp(block_samples);
+    std::vector<int16_t> out(block_samples * 2);
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+
+    for (auto &v : in)
+    {
+        v = gr_complex(value(rng), value(rng));
+    }
+
+    for (auto &kernel : scale_convert_kernels())
+    {
+        printf("fused %-8s %8.1f Msamples/s\n", kernel.name, msamples_per_second(block_samples, [&] {
+            kernel.fn(out.data(), reinterpret_cast<const float *>(in.data()), dac_scaling, block_samples * 2);
+        }));
+    }
+
+    printf("two pass volk  %8.1f Msamples/s\n", msamples_per_second(block_samples, [&] {
+        volk_32f_s32f_multiply_32f(reinterpret_cast<float *>(temp.data()),
+                reinterpret_cast<const float *>(in.data()), dac_scaling, block_samples * 2);
+        volk_32fc_convert_16ic(reinterpret_cast<lv_16sc_t *>(out.data()), temp.data(), block_samples);
+    }));
+
+    return 0;
+}
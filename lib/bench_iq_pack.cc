@@ -0,0 +1,66 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Prints the RX cost per sample of each 12-bit unpack kernel, and of the packed path (unpack
+ * then convert to float) next to the unpacked path (convert only).  Not run by ctest, the
+ * numbers depend on the machine.
+ */
+
+#include "iq_pack.h"
+#include <volk/volk.h>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace gr::sidekiq;
+
+static const uint32_t num_blocks = 20000;
+
+template <typename F>
+static double msamples_per_second(uint32_t block_samples, F &&run)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < num_blocks; i++)
+    {
+        run();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return (static_cast<double>(block_samples) * num_blocks) / seconds / 1e6;
+}
+
+int main()
+{
+    const uint32_t block_samples = packed_samples_in_words(1020);
+    std::vector<uint32_t> packed(packed_words_for_samples(block_samples));
+    std::vector<int16_t> unpacked(block_samples * 2);
+    std::vector<float> converted(block_samples * 2);
+    std::mt19937 rng(3);
+
+    for (auto &word : packed)
+    {
+        word = rng();
+    }
+
+    for (auto &kernel : unpack_12bit_iq_kernels())
+    {
+        printf("unpack %-8s %8.1f Msamples/s\n", kernel.name, msamples_per_second(block_samples,
+                [&] { kernel.fn(unpacked.data(), packed.data(), block_samples); }));
+    }
+
+    printf("unpacked path   %8.1f Msamples/s\n", msamples_per_second(block_samples, [&] {
+        volk_16i_s32f_convert_32f(converted.data(), unpacked.data(), 2047.0f, block_samples * 2);
+    }));
+    printf("packed path     %8.1f Msamples/s\n", msamples_per_second(block_samples, [&] {
+        unpack_12bit_iq(unpacked.data(), packed.data(), block_samples);
+        volk_16i_s32f_convert_32f(converted.data(), unpacked.data(), 2047.0f, block_samples * 2);
+    }));
+
+    return 0;
+}
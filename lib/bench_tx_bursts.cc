@@ -0,0 +1,108 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Sends back to back one block bursts with a block of idle between them, first starting and
+ * stopping the stream for each burst and then in continuous mode, and prints the burst rate
+ * of each.  Needs a card, and is not run by ctest since the rate depends on the machine.
+ */
+
+#include <gnuradio/gr_complex.h>
+#include <gnuradio/io_signature.h>
+#include <gnuradio/sync_block.h>
+#include <gnuradio/top_block.h>
+#include <gnuradio/sidekiq/sidekiq_tx.h>
+#include <sidekiq_api.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+/*
+ * burst_source
+ *
+ * Writes num_items zeros with a burst of burst_samples tagged at the start of every
+ * burst_spacing items.
+ */
+class burst_source : public gr::sync_block
+{
+public:
+    burst_source(uint64_t num_items, const std::string &burst_tag, uint64_t burst_spacing,
+                 uint64_t burst_samples)
+        : gr::sync_block("burst_source", gr::io_signature::make(0, 0, 0),
+                                         gr::io_signature::make(1, 1, sizeof(gr_complex))),
+          num_items(num_items),
+          burst_key(pmt::string_to_symbol(burst_tag)),
+          burst_length(pmt::from_uint64(burst_samples)),
+          burst_spacing(burst_spacing)
+    {
+    }
+
+    int work(int noutput_items, gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items) override
+    {
+        uint64_t start = nitems_written(0);
+
+        if (start >= num_items)
+        {
+            return WORK_DONE;
+        }
+
+        int n = static_cast<int>(std::min<uint64_t>(noutput_items, num_items - start));
+        memset(output_items[0], 0, n * sizeof(gr_complex));
+
+        uint64_t offset = ((start + burst_spacing - 1) / burst_spacing) * burst_spacing;
+        for (; offset < start + n; offset += burst_spacing)
+        {
+            add_item_tag(0, offset, burst_key, burst_length);
+        }
+
+        return n;
+    }
+
+private:
+    uint64_t num_items;
+    pmt::pmt_t burst_key;
+    pmt::pmt_t burst_length;
+    uint64_t burst_spacing;
+};
+
+int main()
+{
+    const uint32_t block_samples = 1020;
+    const uint64_t num_bursts = 2000;
+    const uint64_t burst_spacing = 2 * block_samples;
+    uint8_t cards[SKIQ_MAX_NUM_CARDS]{};
+    uint8_t num_cards = 0;
+
+    if (skiq_get_cards(skiq_xport_type_auto, &num_cards, cards) != 0 || num_cards == 0)
+    {
+        printf("no card found\n");
+        return 1;
+    }
+
+    /* at 10 Msps this spacing caps the rate at about 4900 bursts/s */
+    for (int burst_mode = 0; burst_mode < 2; burst_mode++)
+    {
+        auto tb = gr::make_top_block("bench_tx_bursts");
+        auto source = gnuradio::make_block_sptr<burst_source>(num_bursts * burst_spacing, "tx_burst",
+                burst_spacing, block_samples);
+        auto tx = gr::sidekiq::sidekiq_tx::make(cards[0], skiq_tx_hdl_A1, 10e6, 8e6, 1000e6, 150,
+                "tx_burst", 0, block_samples, 1 /* manual cal */, 0, 20, 0, burst_mode);
+
+        tb->connect(source, 0, tx, 0);
+
+        auto start = std::chrono::steady_clock::now();
+        tb->run();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        printf("burst mode %s %8.1f bursts/s\n", (burst_mode == 0) ? "start/stop" : "continuous",
+                num_bursts / seconds);
+    }
+
+    return 0;
+}
@@ -0,0 +1,189 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "card_manager.h"
+#include <cerrno>
+
+namespace gr {
+namespace sidekiq {
+
+card_manager &card_manager::instance()
+{
+    static card_manager manager;
+
+    return manager;
+}
+
+int32_t card_manager::acquire(const uint8_t *p_cards, uint8_t num_cards, bool *p_shared)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    uint8_t new_cards[SKIQ_MAX_NUM_CARDS];
+    uint8_t num_new = 0;
+    int32_t status = 0;
+
+    *p_shared = false;
+    for (uint8_t i = 0; i < num_cards; i++)
+    {
+        if (p_cards[i] >= SKIQ_MAX_NUM_CARDS)
+        {
+            return -EINVAL;
+        }
+
+        if (state[p_cards[i]].refs > 0)
+        {
+            *p_shared = true;
+        }
+        else
+        {
+            new_cards[num_new++] = p_cards[i];
+        }
+    }
+
+    /* only the cards nobody has enabled yet */
+    if (num_new > 0)
+    {
+        if (initialized == false)
+        {
+            status = skiq_init(skiq_xport_type_pcie, skiq_xport_init_level_full, new_cards, num_new);
+        }
+        else
+        {
+            status = skiq_enable_cards(new_cards, num_new, skiq_xport_init_level_full);
+        }
+
+        if (status != 0)
+        {
+            return status;
+        }
+        initialized = true;
+
+        /* by default all cards are in Q/I order we want it to be I/Q so switch it */
+        for (uint8_t i = 0; i < num_new; i++)
+        {
+            status = skiq_write_iq_order_mode(new_cards[i], skiq_iq_order_iq);
+            if (status != 0)
+            {
+                skiq_disable_cards(new_cards, num_new);
+                if (enabled_cards == 0)
+                {
+                    skiq_exit();
+                    initialized = false;
+                }
+                return status;
+            }
+        }
+    }
+
+    for (uint8_t i = 0; i < num_cards; i++)
+    {
+        card_state &card = state[p_cards[i]];
+
+        if (card.refs++ == 0)
+        {
+            card = card_state{1, 0, false, false};
+            enabled_cards++;
+        }
+    }
+
+    return 0;
+}
+
+void card_manager::release(const uint8_t *p_cards, uint8_t num_cards)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    uint8_t old_cards[SKIQ_MAX_NUM_CARDS];
+    uint8_t num_old = 0;
+
+    for (uint8_t i = 0; i < num_cards; i++)
+    {
+        card_state &card = state[p_cards[i]];
+
+        if (card.refs > 0 && --card.refs == 0)
+        {
+            old_cards[num_old++] = p_cards[i];
+            enabled_cards--;
+        }
+    }
+
+    /* the last card out shuts libsidekiq down, otherwise just let go of the idle cards */
+    if (enabled_cards == 0 && initialized == true)
+    {
+        skiq_exit();
+        initialized = false;
+    }
+    else if (num_old > 0)
+    {
+        skiq_disable_cards(old_cards, num_old);
+    }
+}
+
+int32_t card_manager::set_chan_mode(uint8_t card, bool dual)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    card_state &state_ref = state[card];
+    int32_t status = 0;
+
+    if (state_ref.dual_refs > 0)
+    {
+        /* already dual, and single channel use still works in dual mode */
+        if (dual == true)
+        {
+            state_ref.dual_refs++;
+        }
+        return 0;
+    }
+
+    status = skiq_write_chan_mode(card, dual ? skiq_chan_mode_dual : skiq_chan_mode_single);
+    if (status == 0 && dual == true)
+    {
+        state_ref.dual_refs = 1;
+    }
+
+    return status;
+}
+
+void card_manager::release_dual_chan(uint8_t card)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    card_state &state_ref = state[card];
+
+    if (state_ref.dual_refs == 0 || --state_ref.dual_refs > 0)
+    {
+        return;
+    }
+
+    /* the last dual user is gone, the blocks left on the card only need single channel.  If
+     * the caller is the last block, the card is disabled next and nothing needs writing */
+    if (state_ref.refs > 1)
+    {
+        skiq_write_chan_mode(card, skiq_chan_mode_single);
+    }
+}
+
+int32_t card_manager::set_pack_mode(uint8_t card, bool packed)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    card_state &state_ref = state[card];
+    int32_t status = 0;
+
+    if (state_ref.pack_set == true)
+    {
+        return (state_ref.packed == packed) ? 0 : -EINVAL;
+    }
+
+    status = skiq_write_iq_pack_mode(card, packed);
+    if (status == 0)
+    {
+        state_ref.pack_set = true;
+        state_ref.packed = packed;
+    }
+
+    return status;
+}
+
+} // namespace sidekiq
+} // namespace gr
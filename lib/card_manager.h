@@ -0,0 +1,97 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_SIDEKIQ_CARD_MANAGER_H
+#define INCLUDED_SIDEKIQ_CARD_MANAGER_H
+
+#include <sidekiq_api.h>
+#include <cstdint>
+#include <mutex>
+
+namespace gr {
+namespace sidekiq {
+
+/*
+ * card_manager
+ *
+ * Process wide owner of libsidekiq.  Every RX and TX block acquires its cards here instead of
+ * calling skiq_init() itself.  The first block initializes libsidekiq, later blocks enable any
+ * card that is not enabled yet, and each card is disabled when the last block using it releases
+ * it.  skiq_exit() runs when no card is left.
+ *
+ * The card wide settings that RX and TX both depend on are kept here too, so one block does
+ * not silently change them under another.  All calls return 0 or a libsidekiq style status.
+ */
+class card_manager
+{
+public:
+    static card_manager &instance();
+
+    /* enable num_cards cards for one block, *p_shared is set if another block already had one */
+    int32_t acquire(const uint8_t *p_cards, uint8_t num_cards, bool *p_shared);
+
+    /* give the cards back, disabling the ones nobody else is using */
+    void release(const uint8_t *p_cards, uint8_t num_cards);
+
+    /* dual channel mode is held while any block on the card needs it, a block that asked for
+     * dual gives the request back with release_dual_chan() before it releases the card */
+    int32_t set_chan_mode(uint8_t card, bool dual);
+    void release_dual_chan(uint8_t card);
+
+    /* the first block sets the pack mode, -EINVAL if a later one asks for the other mode */
+    int32_t set_pack_mode(uint8_t card, bool packed);
+
+private:
+    card_manager() = default;
+
+    struct card_state {
+        uint32_t refs;
+        uint32_t dual_refs;
+        bool pack_set;
+        bool packed;
+    };
+
+    std::mutex lock;
+    bool initialized{};
+    uint32_t enabled_cards{};
+    card_state state[SKIQ_MAX_NUM_CARDS]{};
+};
+
+/*
+ * card_guard
+ *
+ * The destructor of a block never runs when its constructor throws.  Created right before
+ * the constructor acquires its cards, the guard calls the block's release method on the way
+ * out unless the constructor reached dismiss().
+ */
+template <typename T>
+class card_guard
+{
+public:
+    card_guard(T *p_block, void (T::*p_release)()) : p_block(p_block), p_release(p_release) {}
+    ~card_guard()
+    {
+        if (p_block != nullptr)
+        {
+            (p_block->*p_release)();
+        }
+    }
+
+    card_guard(const card_guard &) = delete;
+    card_guard &operator=(const card_guard &) = delete;
+
+    void dismiss() { p_block = nullptr; }
+
+private:
+    T *p_block;
+    void (T::*p_release)();
+};
+
+} // namespace sidekiq
+} // namespace gr
+
+#endif /* INCLUDED_SIDEKIQ_CARD_MANAGER_H */
@@ -0,0 +1,46 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "change_waiter.h"
+
+namespace gr {
+namespace sidekiq {
+
+/*
+ * signal() bumps the count before it reads waiters, wait() adds itself to waiters before it
+ * checks the count under the mutex.  All four are sequentially consistent, so either the
+ * waiter sees the new count and does not sleep, or signal() sees the waiter and notifies it.
+ * The notify is done under the mutex so it can not fall between the waiter's check and its
+ * sleep.
+ */
+void change_waiter::signal()
+{
+    change_count.fetch_add(1, std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_seq_cst) > 0)
+    {
+        std::lock_guard<std::mutex> lock(wait_mutex);
+        wait_cond.notify_all();
+    }
+}
+
+bool change_waiter::wait(uint64_t since, std::chrono::microseconds timeout)
+{
+    bool changed{};
+
+    waiters.fetch_add(1, std::memory_order_seq_cst);
+    {
+        std::unique_lock<std::mutex> lock(wait_mutex);
+        changed = wait_cond.wait_for(lock, timeout, [&] {
+                return change_count.load(std::memory_order_seq_cst) != since; });
+    }
+    waiters.fetch_sub(1, std::memory_order_seq_cst);
+
+    return changed;
+}
+
+} // namespace sidekiq
+} // namespace gr
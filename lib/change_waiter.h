@@ -0,0 +1,52 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_SIDEKIQ_CHANGE_WAITER_H
+#define INCLUDED_SIDEKIQ_CHANGE_WAITER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace gr {
+namespace sidekiq {
+
+/*
+ * change_waiter
+ *
+ * Lets a thread wait for a change made by a lock free structure, the TX block pool and the
+ * TX submission queue.  The side making a change calls signal() after it, the mutex is only
+ * taken to wait, and by a signal() that sees somebody waiting.
+ *
+ * A waiter reads changes() before it looks at the structure and passes it to wait(), so a
+ * change in between is not missed.
+ */
+class change_waiter
+{
+public:
+    /* number of signal() calls so far */
+    uint64_t changes() const { return change_count.load(std::memory_order_seq_cst); }
+
+    /* any thread, after the change is visible */
+    void signal();
+
+    /* wait until signal() is called after changes() returned since, false on timeout */
+    bool wait(uint64_t since, std::chrono::microseconds timeout);
+
+private:
+    alignas(64) std::atomic<uint64_t> change_count{};
+    std::atomic<uint32_t> waiters{};
+    std::mutex wait_mutex;
+    std::condition_variable wait_cond;
+};
+
+} // namespace sidekiq
+} // namespace gr
+
+#endif /* INCLUDED_SIDEKIQ_CHANGE_WAITER_H */
@@ -0,0 +1,216 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "iq_convert.h"
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IQ_CONVERT_HAVE_X86
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define IQ_CONVERT_HAVE_NEON
+#endif
+
+#define SC16_MAX        32767.0f
+#define SC16_MIN        -32768.0f
+
+namespace gr {
+namespace sidekiq {
+
+/*
+ * All kernels work on num_values = 2 * samples floats.  Clamping happens in float before the
+ * conversion, an out of range float to int32 conversion is undefined in C and gives INT_MIN
+ * in SIMD, which would wrap a large positive sample to full scale negative.
+ */
+static void convert_generic(int16_t *p_out, const float *p_in, float dac_scaling, uint32_t num_values)
+{
+    for (uint32_t i = 0; i < num_values; i++)
+    {
+        float value = p_in[i] * dac_scaling;
+
+        value = std::fmin(std::fmax(value, SC16_MIN), SC16_MAX);
+        p_out[i] = static_cast<int16_t>(std::lrintf(value));
+    }
+}
+
+#ifdef IQ_CONVERT_HAVE_X86
+__attribute__((target("sse2")))
+static void convert_sse2(int16_t *p_out, const float *p_in, float dac_scaling, uint32_t num_values)
+{
+    const __m128 scale = _mm_set1_ps(dac_scaling);
+    const __m128 max = _mm_set1_ps(SC16_MAX);
+    const __m128 min = _mm_set1_ps(SC16_MIN);
+    uint32_t i = 0;
+
+    /* 8 floats in, 8 shorts out */
+    for (; (i + 8) <= num_values; i += 8)
+    {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(p_in + i), scale);
+        __m128 b = _mm_mul_ps(_mm_loadu_ps(p_in + i + 4), scale);
+
+        a = _mm_min_ps(_mm_max_ps(a, min), max);
+        b = _mm_min_ps(_mm_max_ps(b, min), max);
+
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p_out + i), packed);
+    }
+
+    convert_generic(p_out + i, p_in + i, dac_scaling, num_values - i);
+}
+
+__attribute__((target("avx2")))
+static void convert_avx2(int16_t *p_out, const float *p_in, float dac_scaling, uint32_t num_values)
+{
+    const __m256 scale = _mm256_set1_ps(dac_scaling);
+    const __m256 max = _mm256_set1_ps(SC16_MAX);
+    const __m256 min = _mm256_set1_ps(SC16_MIN);
+    uint32_t i = 0;
+
+    /* 16 floats in, 16 shorts out */
+    for (; (i + 16) <= num_values; i += 16)
+    {
+        __m256 a = _mm256_mul_ps(_mm256_loadu_ps(p_in + i), scale);
+        __m256 b = _mm256_mul_ps(_mm256_loadu_ps(p_in + i + 8), scale);
+
+        a = _mm256_min_ps(_mm256_max_ps(a, min), max);
+        b = _mm256_min_ps(_mm256_max_ps(b, min), max);
+
+        /* packs works within each 128-bit lane, put the lanes back in order */
+        __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        packed = _mm256_permute4x64_epi64(packed, 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p_out + i), packed);
+    }
+
+    convert_generic(p_out + i, p_in + i, dac_scaling, num_values - i);
+}
+
+__attribute__((target("avx512f")))
+static void convert_avx512(int16_t *p_out, const float *p_in, float dac_scaling, uint32_t num_values)
+{
+    const __m512 scale = _mm512_set1_ps(dac_scaling);
+    const __m512 max = _mm512_set1_ps(SC16_MAX);
+    const __m512 min = _mm512_set1_ps(SC16_MIN);
+    uint32_t i = 0;
+
+    /* 16 floats in, 16 shorts out */
+    for (; (i + 16) <= num_values; i += 16)
+    {
+        __m512 a = _mm512_mul_ps(_mm512_loadu_ps(p_in + i), scale);
+
+        a = _mm512_min_ps(_mm512_max_ps(a, min), max);
+
+        __m256i packed = _mm512_cvtsepi32_epi16(_mm512_cvtps_epi32(a));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p_out + i), packed);
+    }
+
+    convert_generic(p_out + i, p_in + i, dac_scaling, num_values - i);
+}
+#endif
+
+#ifdef IQ_CONVERT_HAVE_NEON
+static void convert_neon(int16_t *p_out, const float *p_in, float dac_scaling, uint32_t num_values)
+{
+    const float32x4_t max = vdupq_n_f32(SC16_MAX);
+    const float32x4_t min = vdupq_n_f32(SC16_MIN);
+    uint32_t i = 0;
+
+    /* 8 floats in, 8 shorts out */
+    for (; (i + 8) <= num_values; i += 8)
+    {
+        float32x4_t a = vmulq_n_f32(vld1q_f32(p_in + i), dac_scaling);
+        float32x4_t b = vmulq_n_f32(vld1q_f32(p_in + i + 4), dac_scaling);
+
+        a = vminq_f32(vmaxq_f32(a, min), max);
+        b = vminq_f32(vmaxq_f32(b, min), max);
+
+        int16x8_t packed = vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)), vqmovn_s32(vcvtnq_s32_f32(b)));
+        vst1q_s16(p_out + i, packed);
+    }
+
+    convert_generic(p_out + i, p_in + i, dac_scaling, num_values - i);
+}
+#endif
+
+static convert_kernel select_convert()
+{
+#ifdef IQ_CONVERT_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        return {convert_avx512, "avx512"};
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return {convert_avx2, "avx2"};
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return {convert_sse2, "sse2"};
+    }
+#endif
+#ifdef IQ_CONVERT_HAVE_NEON
+    return {convert_neon, "neon"};
+#endif
+    return {convert_generic, "generic"};
+}
+
+static const convert_kernel convert_impl = select_convert();
+
+void scale_convert_32fc_16ic(int16_t *p_out, const float *p_in, float dac_scaling, uint32_t num_samples)
+{
+    convert_impl.fn(p_out, p_in, dac_scaling, num_samples * 2);
+}
+
+/* simple enough for the compiler to vectorize, the rounding is done in 32 bits so the largest 
+ * positive value does not wrap and is clamped back to the top of the DAC range instead */
+void shift_16ic(int16_t *p_out, const int16_t *p_in, uint32_t shift, uint32_t num_samples)
+{
+    const int32_t round = (1 << shift) >> 1;
+    const int32_t max = (32767 >> shift);
+    uint32_t num_values = num_samples * 2;
+
+    for (uint32_t i = 0; i < num_values; i++)
+    {
+        int32_t value = (static_cast<int32_t>(p_in[i]) + round) >> shift;
+
+        p_out[i] = static_cast<int16_t>((value > max) ? max : value);
+    }
+}
+
+const char *scale_convert_kernel_name()
+{
+    return convert_impl.name;
+}
+
+std::vector<convert_kernel> scale_convert_kernels()
+{
+    std::vector<convert_kernel> kernels{ {convert_generic, "generic"} };
+
+#ifdef IQ_CONVERT_HAVE_X86
+    if (__builtin_cpu_supports("sse2"))
+    {
+        kernels.push_back({convert_sse2, "sse2"});
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        kernels.push_back({convert_avx2, "avx2"});
+    }
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        kernels.push_back({convert_avx512, "avx512"});
+    }
+#endif
+#ifdef IQ_CONVERT_HAVE_NEON
+    kernels.push_back({convert_neon, "neon"});
+#endif
+
+    return kernels;
+}
+
+} // namespace sidekiq
+} // namespace gr
@@ -0,0 +1,51 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_SIDEKIQ_IQ_CONVERT_H
+#define INCLUDED_SIDEKIQ_IQ_CONVERT_H
+
+#include <gnuradio/sidekiq/api.h>
+#include <cstdint>
+#include <vector>
+
+namespace gr {
+namespace sidekiq {
+
+/*
+ * Fused TX sample conversion
+ *
+ * Scales float I/Q by dac_scaling, saturates to the int16 range and rounds to the nearest
+ * integer in one pass, writing straight into the DMA block.  This replaces a multiply into a
+ * float scratch buffer followed by a separate convert.  The kernel is picked once at load
+ * time from AVX-512, AVX2, SSE2 or NEON, with a plain C fallback.
+ */
+
+/* convert num_samples float I/Q pairs into int16 I/Q pairs */
+SIDEKIQ_API void scale_convert_32fc_16ic(int16_t *p_out, const float *p_in, float dac_scaling, uint32_t num_samples);
+
+/* shift num_samples full scale int16 I/Q pairs down to a DAC of 16 - shift bits, rounding to 
+ * the nearest value without overflowing */
+SIDEKIQ_API void shift_16ic(int16_t *p_out, const int16_t *p_in, uint32_t shift, uint32_t num_samples);
+
+/* name of the kernel picked for this CPU, for the log */
+SIDEKIQ_API const char *scale_convert_kernel_name();
+
+/* a kernel converts num_values floats, two per sample */
+typedef void (*convert_fn_t)(int16_t *p_out, const float *p_in, float dac_scaling, uint32_t num_values);
+
+struct convert_kernel {
+    convert_fn_t fn;
+    const char *name;
+};
+
+/* every convert kernel this CPU can run, the plain C one first, for the unit tests */
+SIDEKIQ_API std::vector<convert_kernel> scale_convert_kernels();
+
+} // namespace sidekiq
+} // namespace gr
+
+#endif /* INCLUDED_SIDEKIQ_IQ_CONVERT_H */
@@ -0,0 +1,186 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "iq_pack.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IQ_PACK_HAVE_SSSE3
+#endif
+
+#define SAMPLES_PER_GROUP       4       // complex samples in one packed group
+#define WORDS_PER_GROUP         3       // 32-bit words in one packed group
+#define BITS_PER_COMPONENT      12
+
+namespace gr {
+namespace sidekiq {
+
+typedef void (*unpack_fn_t)(int16_t *p_out, const uint32_t *p_in, uint32_t num_samples);
+
+static inline int16_t sign_extend_12(uint32_t value)
+{
+    return static_cast<int16_t>(static_cast<int16_t>((value & 0xFFF) << 4) >> 4);
+}
+
+/* read the 12-bit field starting bit_offset bits below the msb of p_in[0] */
+static inline uint32_t read_12(const uint32_t *p_in, uint32_t bit_offset)
+{
+    uint32_t word = bit_offset / 32;
+    uint32_t bit = bit_offset % 32;
+
+    if (bit <= (32 - BITS_PER_COMPONENT))
+    {
+        return (p_in[word] >> (32 - BITS_PER_COMPONENT - bit)) & 0xFFF;
+    }
+
+    /* the field spans two words */
+    uint32_t high_bits = 32 - bit;
+    uint32_t low_bits = BITS_PER_COMPONENT - high_bits;
+
+    return ((p_in[word] & ((1u << high_bits) - 1)) << low_bits) | (p_in[word + 1] >> (32 - low_bits));
+}
+
+/* the partial group at the end of a block, or of a run handled by the SIMD kernel */
+static void unpack_tail(int16_t *p_out, const uint32_t *p_in, uint32_t num_samples)
+{
+    for (uint32_t i = 0; i < num_samples; i++)
+    {
+        p_out[2 * i] = sign_extend_12(read_12(p_in, i * 2 * BITS_PER_COMPONENT));
+        p_out[(2 * i) + 1] = sign_extend_12(read_12(p_in, ((i * 2) + 1) * BITS_PER_COMPONENT));
+    }
+}
+
+static void unpack_12bit_iq_generic(int16_t *p_out, const uint32_t *p_in, uint32_t num_samples)
+{
+    uint32_t num_groups = num_samples / SAMPLES_PER_GROUP;
+
+    for (uint32_t g = 0; g < num_groups; g++)
+    {
+        uint32_t w0 = p_in[0];
+        uint32_t w1 = p_in[1];
+        uint32_t w2 = p_in[2];
+
+        p_out[0] = sign_extend_12(w0 >> 20);
+        p_out[1] = sign_extend_12(w0 >> 8);
+        p_out[2] = sign_extend_12(((w0 & 0xFF) << 4) | (w1 >> 28));
+        p_out[3] = sign_extend_12(w1 >> 16);
+        p_out[4] = sign_extend_12(w1 >> 4);
+        p_out[5] = sign_extend_12(((w1 & 0xF) << 8) | (w2 >> 24));
+        p_out[6] = sign_extend_12(w2 >> 12);
+        p_out[7] = sign_extend_12(w2);
+
+        p_in += WORDS_PER_GROUP;
+        p_out += SAMPLES_PER_GROUP * 2;
+    }
+
+    unpack_tail(p_out, p_in, num_samples % SAMPLES_PER_GROUP);
+}
+
+#ifdef IQ_PACK_HAVE_SSSE3
+/*
+ * One group per iteration: shuffle the two bytes holding each component into a 16-bit lane,
+ * components in the upper 12 bits just need an arithmetic shift, components in the lower
+ * 12 bits are first moved up by multiplying by 16.
+ */
+__attribute__((target("ssse3")))
+static void unpack_12bit_iq_ssse3(int16_t *p_out, const uint32_t *p_in, uint32_t num_samples)
+{
+    const __m128i shuffle = _mm_setr_epi8(2, 3, 1, 2, 7, 0, 6, 7, 4, 5, 11, 4, 9, 10, 8, 9);
+    const __m128i align = _mm_setr_epi16(1, 16, 1, 16, 1, 16, 1, 16);
+
+    uint32_t num_groups = num_samples / SAMPLES_PER_GROUP;
+    uint32_t num_words = packed_words_for_samples(num_samples);
+    uint32_t g = 0;
+
+    /* each load reads 16 bytes for a 12 byte group, stay inside the input */
+    for (; (g < num_groups) && (((g * WORDS_PER_GROUP) + 4) <= num_words); g++)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p_in + (g * WORDS_PER_GROUP)));
+        v = _mm_shuffle_epi8(v, shuffle);
+        v = _mm_mullo_epi16(v, align);
+        v = _mm_srai_epi16(v, 4);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p_out + (g * SAMPLES_PER_GROUP * 2)), v);
+    }
+
+    unpack_12bit_iq_generic(p_out + (g * SAMPLES_PER_GROUP * 2),
+                            p_in + (g * WORDS_PER_GROUP),
+                            num_samples - (g * SAMPLES_PER_GROUP));
+}
+#endif
+
+static unpack_fn_t select_unpack()
+{
+#ifdef IQ_PACK_HAVE_SSSE3
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3"))
+    {
+        return unpack_12bit_iq_ssse3;
+    }
+#endif
+    return unpack_12bit_iq_generic;
+}
+
+static const unpack_fn_t unpack_impl = select_unpack();
+
+void unpack_12bit_iq(int16_t *p_out, const uint32_t *p_in, uint32_t num_samples)
+{
+    unpack_impl(p_out, p_in, num_samples);
+}
+
+std::vector<unpack_kernel> unpack_12bit_iq_kernels()
+{
+    std::vector<unpack_kernel> kernels{ {unpack_12bit_iq_generic, "generic"} };
+
+#ifdef IQ_PACK_HAVE_SSSE3
+    if (__builtin_cpu_supports("ssse3"))
+    {
+        kernels.push_back({unpack_12bit_iq_ssse3, "ssse3"});
+    }
+#endif
+
+    return kernels;
+}
+
+void pack_12bit_iq(uint32_t *p_out, const int16_t *p_in, uint32_t num_samples)
+{
+    uint32_t num_groups = num_samples / SAMPLES_PER_GROUP;
+    uint32_t remaining = num_samples % SAMPLES_PER_GROUP;
+
+    for (uint32_t g = 0; g < num_groups; g++)
+    {
+        uint32_t i0 = p_in[0] & 0xFFF;
+        uint32_t q0 = p_in[1] & 0xFFF;
+        uint32_t i1 = p_in[2] & 0xFFF;
+        uint32_t q1 = p_in[3] & 0xFFF;
+        uint32_t i2 = p_in[4] & 0xFFF;
+        uint32_t q2 = p_in[5] & 0xFFF;
+        uint32_t i3 = p_in[6] & 0xFFF;
+        uint32_t q3 = p_in[7] & 0xFFF;
+
+        p_out[0] = (i0 << 20) | (q0 << 8) | (i1 >> 4);
+        p_out[1] = (i1 << 28) | (q1 << 16) | (i2 << 4) | (q2 >> 8);
+        p_out[2] = (q2 << 24) | (i3 << 12) | q3;
+
+        p_in += SAMPLES_PER_GROUP * 2;
+        p_out += WORDS_PER_GROUP;
+    }
+
+    if (remaining > 0)
+    {
+        /* zero pad the last group and only write the words it needs */
+        int16_t last_in[SAMPLES_PER_GROUP * 2]{};
+        uint32_t last_out[WORDS_PER_GROUP]{};
+
+        memcpy(last_in, p_in, remaining * 2 * sizeof(int16_t));
+        pack_12bit_iq(last_out, last_in, SAMPLES_PER_GROUP);
+        memcpy(p_out, last_out, packed_words_for_samples(remaining) * sizeof(uint32_t));
+    }
+}
+
+} // namespace sidekiq
+} // namespace gr
@@ -0,0 +1,62 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_SIDEKIQ_IQ_PACK_H
+#define INCLUDED_SIDEKIQ_IQ_PACK_H
+
+#include <gnuradio/sidekiq/api.h>
+#include <cstdint>
+#include <vector>
+
+namespace gr {
+namespace sidekiq {
+
+/*
+ * Packed 12-bit I/Q helpers
+ *
+ * In packed mode 4 complex samples of 12-bit I and Q share 3 32-bit words.  The samples are
+ * a bit stream read from the most significant bit of the first word down:
+ *
+ *   word 0:  I0[11:0] Q0[11:0] I1[11:4]
+ *   word 1:  I1[3:0]  Q1[11:0] I2[11:0] Q2[11:8]
+ *   word 2:  Q2[7:0]  I3[11:0] Q3[11:0]
+ *
+ * Each DMA block is packed on its own.  A block whose payload is not a multiple of 3 words
+ * ends with a partial group, 1 word holds 1 complete sample and 2 words hold 2, the left over
+ * bits are padding.  The unpacked samples are sign extended into I/Q int16 pairs.
+ */
+
+/* number of complete samples held by num_words of packed data */
+static inline uint32_t packed_samples_in_words(uint32_t num_words)
+{
+    return (num_words * 4) / 3;
+}
+
+/* number of words needed to pack num_samples, the last group is padded */
+static inline uint32_t packed_words_for_samples(uint32_t num_samples)
+{
+    return ((num_samples * 3) + 3) / 4;
+}
+
+/* unpack num_samples from p_in into I/Q int16 pairs, uses SSSE3 when the CPU has it */
+SIDEKIQ_API void unpack_12bit_iq(int16_t *p_out, const uint32_t *p_in, uint32_t num_samples);
+
+/* pack num_samples I/Q int16 pairs into p_out, the padding bits of the last word are zero */
+SIDEKIQ_API void pack_12bit_iq(uint32_t *p_out, const int16_t *p_in, uint32_t num_samples);
+
+struct unpack_kernel {
+    void (*fn)(int16_t *p_out, const uint32_t *p_in, uint32_t num_samples);
+    const char *name;
+};
+
+/* every unpack kernel this CPU can run, the plain C one first, for the unit tests */
+SIDEKIQ_API std::vector<unpack_kernel> unpack_12bit_iq_kernels();
+
+} // namespace sidekiq
+} // namespace gr
+
+#endif /* INCLUDED_SIDEKIQ_IQ_PACK_H */
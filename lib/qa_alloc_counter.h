@@ -0,0 +1,83 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_SIDEKIQ_QA_ALLOC_COUNTER_H
+#define INCLUDED_SIDEKIQ_QA_ALLOC_COUNTER_H
+
+/*
+ * Replaces the global operator new of a unit test executable so a test can count the heap
+ * allocations every thread makes while counting is on.  The replacements are not inline, so
+ * include this in exactly one qa file of an executable (each GR_ADD_CPP_TEST is its own).
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace gr {
+namespace sidekiq {
+
+inline std::atomic<bool> alloc_counting{ false };
+inline std::atomic<uint64_t> alloc_count{ 0 };
+
+inline void start_alloc_count()
+{
+    alloc_count = 0;
+    alloc_counting = true;
+}
+
+inline uint64_t stop_alloc_count()
+{
+    alloc_counting = false;
+    return alloc_count;
+}
+
+} // namespace sidekiq
+} // namespace gr
+
+void *operator new(std::size_t size)
+{
+    if (gr::sidekiq::alloc_counting.load(std::memory_order_relaxed) == true)
+    {
+        gr::sidekiq::alloc_count++;
+    }
+
+    void *p = std::malloc((size != 0) ? size : 1);
+    if (p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+void *operator new(std::size_t size, std::align_val_t align)
+{
+    if (gr::sidekiq::alloc_counting.load(std::memory_order_relaxed) == true)
+    {
+        gr::sidekiq::alloc_count++;
+    }
+
+    /* aligned_alloc() wants a size that is a multiple of the alignment */
+    std::size_t alignment = static_cast<std::size_t>(align);
+    std::size_t rounded = ((size + alignment - 1) / alignment) * alignment;
+    void *p = std::aligned_alloc(alignment, (rounded != 0) ? rounded : alignment);
+    if (p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+#endif /* INCLUDED_SIDEKIQ_QA_ALLOC_COUNTER_H */
@@ -0,0 +1,78 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "iq_convert.h"
+#include <gnuradio/attributes.h>
+#include <boost/test/unit_test.hpp>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace gr {
+namespace sidekiq {
+
+static const float dac_scaling = 2047.0f;
+
+BOOST_AUTO_TEST_CASE(t_convert_saturates_and_rounds)
+{
+    const float in[] = { 0.0f, 1.0f, -1.0f, 1e6f, -1e6f,
+                         std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+                         0.5f / dac_scaling, 1.5f / dac_scaling };
+    const int16_t expected[] = { 0, 2047, -2047, 32767, -32768, 32767, -32768, 0, 2 };
+    const uint32_t num_values = sizeof(in) / sizeof(in[0]);
+    int16_t out[num_values]{};
+
+    for (auto &kernel : scale_convert_kernels())
+    {
+        BOOST_TEST_MESSAGE("kernel " << kernel.name);
+        kernel.fn(out, in, dac_scaling, num_values);
+        BOOST_CHECK_EQUAL_COLLECTIONS(out, out + num_values, expected, expected + num_values);
+    }
+}
+
+/* every SIMD kernel matches the C one bit for bit, for lengths that leave each tail size */
+BOOST_AUTO_TEST_CASE(t_convert_kernels_match_generic)
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> value(-20.0f, 20.0f);
+    auto kernels = scale_convert_kernels();
+
+    BOOST_REQUIRE(kernels.empty() == false);
+    for (uint32_t num_samples = 0; num_samples <= 70; num_samples++)
+    {
+        std::vector<float> in(num_samples * 2);
+        std::vector<int16_t> expected(num_samples * 2);
+        std::vector<int16_t> out(num_samples * 2);
+
+        /* mostly in range, some far enough out to saturate */
+        for (auto &v : in)
+        {
+            v = value(rng);
+        }
+
+        kernels[0].fn(expected.data(), in.data(), dac_scaling, num_samples * 2);
+        for (auto &kernel : kernels)
+        {
+            BOOST_TEST_MESSAGE("kernel " << kernel.name << ", " << num_samples << " samples");
+            kernel.fn(out.data(), in.data(), dac_scaling, num_samples * 2);
+            BOOST_CHECK_EQUAL_COLLECTIONS(out.begin(), out.end(), expected.begin(), expected.end());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(t_shift_rounds_without_overflow)
+{
+    const int16_t in[] = { 0, 7, 8, -8, -9, 32767, -32768, 32760 };
+    const int16_t expected[] = { 0, 0, 1, 0, -1, 2047, -2048, 2047 };
+    int16_t out[8]{};
+
+    shift_16ic(out, in, 4, 4);
+    BOOST_CHECK_EQUAL_COLLECTIONS(out, out + 8, expected, expected + 8);
+}
+
+} /* namespace sidekiq */
+} /* namespace gr */
@@ -0,0 +1,99 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "iq_pack.h"
+#include <gnuradio/attributes.h>
+#include <boost/test/unit_test.hpp>
+#include <random>
+#include <vector>
+
+namespace gr {
+namespace sidekiq {
+
+/* whole groups, every partial group, and block sized runs with and without a partial tail */
+static const uint32_t sample_counts[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 15, 16, 17, 1361, 1362, 1363, 1364 };
+
+BOOST_AUTO_TEST_CASE(t_pack_known_group)
+{
+    /* (1, -1), (2047, -2048), (-2, 3), (0, 5) */
+    const int16_t samples[] = { 1, -1, 2047, -2048, -2, 3, 0, 5 };
+    const uint32_t words[] = { 0x001FFF7F, 0xF800FFE0, 0x03000005 };
+    uint32_t packed[3]{};
+    int16_t unpacked[8]{};
+
+    pack_12bit_iq(packed, samples, 4);
+    BOOST_CHECK_EQUAL_COLLECTIONS(packed, packed + 3, words, words + 3);
+
+    for (auto &kernel : unpack_12bit_iq_kernels())
+    {
+        BOOST_TEST_MESSAGE("kernel " << kernel.name);
+        kernel.fn(unpacked, words, 4);
+        BOOST_CHECK_EQUAL_COLLECTIONS(unpacked, unpacked + 8, samples, samples + 8);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(t_pack_unpack_round_trip)
+{
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> component(-2048, 2047);
+
+    for (uint32_t num_samples : sample_counts)
+    {
+        std::vector<int16_t> samples(num_samples * 2);
+        std::vector<uint32_t> packed(packed_words_for_samples(num_samples));
+        std::vector<int16_t> unpacked(num_samples * 2);
+
+        for (auto &value : samples)
+        {
+            value = static_cast<int16_t>(component(rng));
+        }
+
+        pack_12bit_iq(packed.data(), samples.data(), num_samples);
+        unpack_12bit_iq(unpacked.data(), packed.data(), num_samples);
+        BOOST_CHECK_EQUAL_COLLECTIONS(unpacked.begin(), unpacked.end(), samples.begin(), samples.end());
+
+        /* the padding after the last sample of a partial group is zero */
+        uint32_t used_bits = num_samples * 24;
+        if ((used_bits % 32) != 0)
+        {
+            BOOST_CHECK_EQUAL(packed.back() & ((1u << (32 - (used_bits % 32))) - 1), 0u);
+        }
+    }
+}
+
+/* any input words, including padding bits that are not zero, unpack the same with every kernel */
+BOOST_AUTO_TEST_CASE(t_unpack_kernels_match_generic)
+{
+    std::mt19937 rng(2);
+    auto kernels = unpack_12bit_iq_kernels();
+
+    BOOST_REQUIRE(kernels.empty() == false);
+    for (uint32_t num_samples : sample_counts)
+    {
+        /* exactly the words the samples need, a kernel reading past them would be caught by a
+         * sanitizer build */
+        std::vector<uint32_t> packed(packed_words_for_samples(num_samples));
+        std::vector<int16_t> expected(num_samples * 2);
+        std::vector<int16_t> unpacked(num_samples * 2);
+
+        for (auto &word : packed)
+        {
+            word = rng();
+        }
+
+        kernels[0].fn(expected.data(), packed.data(), num_samples);
+        for (auto &kernel : kernels)
+        {
+            BOOST_TEST_MESSAGE("kernel " << kernel.name << ", " << num_samples << " samples");
+            kernel.fn(unpacked.data(), packed.data(), num_samples);
+            BOOST_CHECK_EQUAL_COLLECTIONS(unpacked.begin(), unpacked.end(), expected.begin(), expected.end());
+        }
+    }
+}
+
+} /* namespace sidekiq */
+} /* namespace gr */
@@ -0,0 +1,239 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "qa_alloc_counter.h"
+#include <gnuradio/attributes.h>
+#include <gnuradio/gr_complex.h>
+#include <gnuradio/io_signature.h>
+#include <gnuradio/sync_block.h>
+#include <gnuradio/top_block.h>
+#include <gnuradio/sidekiq/sidekiq_rx.h>
+#include <sidekiq_api.h>
+#include <boost/test/unit_test.hpp>
+#include <vector>
+
+namespace gr {
+namespace sidekiq {
+
+/* the hardware tests skip themselves when the cards they need are not there */
+static uint8_t find_cards(uint8_t *p_cards)
+{
+    uint8_t num_cards = 0;
+
+    if (skiq_get_cards(skiq_xport_type_auto, &num_cards, p_cards) != 0)
+    {
+        return 0;
+    }
+
+    return num_cards;
+}
+
+/*
+ * tag_sink
+ *
+ * Keeps the rf_timestamp tags of its input and is done after num_items.
+ */
+class tag_sink : public gr::sync_block
+{
+public:
+    tag_sink(size_t item_size, uint64_t num_items)
+        : gr::sync_block("tag_sink", gr::io_signature::make(1, 1, item_size),
+                                     gr::io_signature::make(0, 0, 0)),
+          num_items(num_items)
+    {
+    }
+
+    int work(int noutput_items, gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items) override
+    {
+        std::vector<gr::tag_t> found;
+        uint64_t start = nitems_read(0);
+
+        if (start >= num_items)
+        {
+            return WORK_DONE;
+        }
+
+        get_tags_in_range(found, 0, start, start + noutput_items, pmt::string_to_symbol("rf_timestamp"));
+        tags.insert(tags.end(), found.begin(), found.end());
+
+        return noutput_items;
+    }
+
+    std::vector<gr::tag_t> tags;
+
+private:
+    uint64_t num_items;
+};
+
+/*
+ * alloc_window_sink
+ *
+ * Counts the heap allocations of every thread, and the rf_timestamp tags it reads, while it
+ * reads items warmup_items up to warmup_items + window_items, then is done.
+ */
+class alloc_window_sink : public gr::sync_block
+{
+public:
+    alloc_window_sink(size_t item_size, uint64_t warmup_items, uint64_t window_items)
+        : gr::sync_block("alloc_window_sink", gr::io_signature::make(1, 1, item_size),
+                                              gr::io_signature::make(0, 0, 0)),
+          warmup_items(warmup_items),
+          window_items(window_items),
+          rf_timestamp_key(pmt::string_to_symbol("rf_timestamp"))
+    {
+        /* get_tags_in_range() clears and refills this, it must not grow inside the window */
+        found.reserve(4096);
+    }
+
+    int work(int noutput_items, gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items) override
+    {
+        uint64_t start = nitems_read(0);
+
+        if (start >= warmup_items + window_items)
+        {
+            allocations = stop_alloc_count();
+            return WORK_DONE;
+        }
+        if (start >= warmup_items)
+        {
+            if (alloc_counting == false)
+            {
+                start_alloc_count();
+            }
+
+            get_tags_in_range(found, 0, start, start + noutput_items);
+            for (auto &tag : found)
+            {
+                if (pmt::eq(tag.key, rf_timestamp_key))
+                {
+                    rf_timestamp_tags++;
+                }
+            }
+        }
+
+        return noutput_items;
+    }
+
+    uint64_t allocations = UINT64_MAX;
+    uint64_t rf_timestamp_tags = 0;
+
+private:
+    uint64_t warmup_items;
+    uint64_t window_items;
+    pmt::pmt_t rf_timestamp_key;
+    std::vector<gr::tag_t> found;
+};
+
+static std::shared_ptr<alloc_window_sink> run_alloc_window(uint8_t card, int timestamp_tags)
+{
+    const int unused_port = 100;
+    auto tb = gr::make_top_block("qa_sidekiq_rx");
+    auto rx = sidekiq_rx::make(card, skiq_rx_hdl_A1, unused_port, 10e6, 8e6, 1000e6,
+            skiq_rx_gain_auto, 0, timestamp_tags, 0, 0, 2 /* cal off */, 0);
+    auto sink = gnuradio::make_block_sptr<alloc_window_sink>(sizeof(gr_complex), 10000000, 20000000);
+
+    tb->connect(rx, 0, sink, 0);
+    tb->run();
+
+    return sink;
+}
+
+/*
+ * Without timestamp tags nothing on the way from RX work() to the sink allocates once 
+ * streaming.
+ */
+BOOST_AUTO_TEST_CASE(t_rx_work_without_tags_does_not_allocate)
+{
+    uint8_t cards[SKIQ_MAX_NUM_CARDS]{};
+
+    if (find_cards(cards) < 1)
+    {
+        BOOST_TEST_MESSAGE("no card found, skipping");
+        return;
+    }
+
+    auto sink = run_alloc_window(cards[0], 0);
+
+    BOOST_CHECK_EQUAL(sink->allocations, 0u);
+}
+
+/*
+ * With timestamp tags, the default, every DMA block still allocates: the tag value is a new 
+ * pmt, and the scheduler keeps each tag in a node of its own.  Neither can be reused, so 
+ * the check is that the allocations stay a small number per rf_timestamp tag and do not 
+ * grow with the samples.  The sink's count lags the block's by up to a buffer of tags.
+ */
+BOOST_AUTO_TEST_CASE(t_rx_work_allocates_only_per_tag)
+{
+    const uint64_t allocations_per_tag = 4;
+    const uint64_t buffer_tags = 64;
+    uint8_t cards[SKIQ_MAX_NUM_CARDS]{};
+
+    if (find_cards(cards) < 1)
+    {
+        BOOST_TEST_MESSAGE("no card found, skipping");
+        return;
+    }
+
+    auto sink = run_alloc_window(cards[0], 1);
+
+    BOOST_TEST_MESSAGE(sink->allocations << " allocations for " << sink->rf_timestamp_tags << " tags");
+    BOOST_REQUIRE(sink->rf_timestamp_tags > 0);
+    BOOST_CHECK_LE(sink->allocations, allocations_per_tag * (sink->rf_timestamp_tags + buffer_tags));
+}
+
+/*
+ * With several cards the ports are aligned and every work() call ends part way through a
+ * block, so each port carries samples over.  Zero fill keeps every output on its rf_timestamp
+ * even across an overrun, so a block that went missing without a tag shows up as a port whose
+ * rf_timestamp tags no longer step with the output offset.
+ */
+BOOST_AUTO_TEST_CASE(t_multi_card_keeps_every_block)
+{
+    const uint64_t num_items = 20000000;
+    const int unused_port = 100;
+    uint8_t cards[SKIQ_MAX_NUM_CARDS]{};
+    uint8_t num_cards = find_cards(cards);
+
+    if (num_cards < 2)
+    {
+        BOOST_TEST_MESSAGE("fewer than 2 cards found, skipping");
+        return;
+    }
+
+    auto tb = gr::make_top_block("qa_sidekiq_rx");
+    auto rx = sidekiq_rx::make(cards[0], skiq_rx_hdl_A1, unused_port, 10e6, 8e6, 1000e6,
+            skiq_rx_gain_auto, 0, 1 /* timestamp tags */, 0, 0, 2 /* cal off */, 0,
+            0, 1 /* sc16 */, 1, 0, 0, 1 /* zero fill */, unused_port, unused_port,
+            std::vector<int>{ cards[1] });
+    std::vector<std::shared_ptr<tag_sink>> sinks;
+
+    for (int i = 0; i < 2; i++)
+    {
+        sinks.push_back(gnuradio::make_block_sptr<tag_sink>(2 * sizeof(int16_t), num_items));
+        tb->connect(rx, i, sinks.back(), 0);
+    }
+    tb->run();
+
+    /* every tag of every port sits at the same rf_timestamp minus output offset */
+    BOOST_REQUIRE(sinks[0]->tags.empty() == false);
+    uint64_t start = pmt::to_uint64(sinks[0]->tags[0].value) - sinks[0]->tags[0].offset;
+
+    for (auto &sink : sinks)
+    {
+        BOOST_REQUIRE(sink->tags.size() > 1);
+        for (auto &tag : sink->tags)
+        {
+            BOOST_REQUIRE_EQUAL(pmt::to_uint64(tag.value) - tag.offset, start);
+        }
+    }
+}
+
+} /* namespace sidekiq */
+} /* namespace gr */
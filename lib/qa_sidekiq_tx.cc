@@ -0,0 +1,118 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "qa_alloc_counter.h"
+#include <gnuradio/attributes.h>
+#include <gnuradio/gr_complex.h>
+#include <gnuradio/io_signature.h>
+#include <gnuradio/sync_block.h>
+#include <gnuradio/top_block.h>
+#include <gnuradio/sidekiq/sidekiq_tx.h>
+#include <sidekiq_api.h>
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <cstring>
+
+namespace gr {
+namespace sidekiq {
+
+static const uint32_t block_samples = 1020;
+
+/* the hardware tests skip themselves when there is no card */
+static bool find_card(uint8_t *p_card)
+{
+    uint8_t cards[SKIQ_MAX_NUM_CARDS]{};
+    uint8_t num_cards = 0;
+
+    if (skiq_get_cards(skiq_xport_type_auto, &num_cards, cards) != 0 || num_cards == 0)
+    {
+        return false;
+    }
+
+    *p_card = cards[0];
+    return true;
+}
+
+/*
+ * zero_source
+ *
+ * Writes num_items zeros.  With a count window it counts the heap allocations of every
+ * thread while it writes items window_start up to window_end.
+ */
+class zero_source : public gr::sync_block
+{
+public:
+    zero_source(uint64_t num_items)
+        : gr::sync_block("zero_source", gr::io_signature::make(0, 0, 0),
+                                        gr::io_signature::make(1, 1, sizeof(gr_complex))),
+          num_items(num_items)
+    {
+    }
+
+    void set_count_window(uint64_t start, uint64_t end)
+    {
+        window_start = start;
+        window_end = end;
+    }
+
+    int work(int noutput_items, gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items) override
+    {
+        uint64_t start = nitems_written(0);
+
+        if (start >= window_end && alloc_counting == true)
+        {
+            allocations = stop_alloc_count();
+        }
+        if (start >= num_items)
+        {
+            return WORK_DONE;
+        }
+        if (start >= window_start && start < window_end && alloc_counting == false)
+        {
+            start_alloc_count();
+        }
+
+        int n = static_cast<int>(std::min<uint64_t>(noutput_items, num_items - start));
+        memset(output_items[0], 0, n * sizeof(gr_complex));
+
+        return n;
+    }
+
+    uint64_t allocations = UINT64_MAX;
+
+private:
+    uint64_t num_items;
+    uint64_t window_start = UINT64_MAX;
+    uint64_t window_end = UINT64_MAX;
+};
+
+/* Once TX is streaming nothing on the way from the source through work() allocates. */
+BOOST_AUTO_TEST_CASE(t_tx_work_does_not_allocate)
+{
+    uint8_t card = 0;
+
+    if (find_card(&card) == false)
+    {
+        BOOST_TEST_MESSAGE("no card found, skipping");
+        return;
+    }
+
+    auto tb = gr::make_top_block("qa_sidekiq_tx");
+    auto source = gnuradio::make_block_sptr<zero_source>(30000000);
+    auto tx = sidekiq_tx::make(card, skiq_tx_hdl_A1, 10e6, 8e6, 1000e6, 150, "", 0,
+            block_samples, 1 /* manual cal */);
+
+    source->set_count_window(10000000, 20000000);
+    tb->connect(source, 0, tx, 0);
+    tb->run();
+
+    BOOST_CHECK_EQUAL(source->allocations, 0u);
+}
+
+} /* namespace sidekiq */
+} /* namespace gr */
@@ -0,0 +1,74 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "rx_block_ring.h"
+#include <cstring>
+
+namespace gr {
+namespace sidekiq {
+
+rx_block_ring::rx_block_ring(uint32_t num_slots, uint32_t slot_size_bytes)
+    : slot_words((slot_size_bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t)),
+      slots(num_slots)
+{
+    storage.resize(static_cast<size_t>(slots.capacity()) * slot_words);
+    for (uint32_t i = 0; i < slots.capacity(); i++)
+    {
+        slots.slot(i).p_data = &storage[static_cast<size_t>(i) * slot_words];
+    }
+}
+
+bool rx_block_ring::push(uint32_t card_index, skiq_rx_hdl_t hdl, const skiq_rx_block_t *p_block, uint32_t length_bytes)
+{
+    slot_info *p_slot = slots.back();
+
+    if (p_slot == NULL)
+    {
+        drop_count.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    if (length_bytes > slot_words * sizeof(uint64_t))
+    {
+        length_bytes = slot_words * sizeof(uint64_t);
+    }
+
+    memcpy(p_slot->p_data, p_block, length_bytes);
+    p_slot->card_index = card_index;
+    p_slot->hdl = hdl;
+    p_slot->length_bytes = length_bytes;
+
+    slots.push();
+
+    return true;
+}
+
+bool rx_block_ring::front(uint32_t *p_card_index, skiq_rx_hdl_t *p_hdl, skiq_rx_block_t **pp_block, uint32_t *p_length_bytes)
+{
+    slot_info *p_slot = slots.front();
+
+    if (p_slot == NULL)
+    {
+        return false;
+    }
+
+    *p_card_index = p_slot->card_index;
+    *p_hdl = p_slot->hdl;
+    *pp_block = reinterpret_cast<skiq_rx_block_t *>(p_slot->p_data);
+    *p_length_bytes = p_slot->length_bytes;
+
+    return true;
+}
+
+void rx_block_ring::reset()
+{
+    slots.reset();
+    drop_count.store(0, std::memory_order_relaxed);
+}
+
+} // namespace sidekiq
+} // namespace gr
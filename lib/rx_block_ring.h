@@ -0,0 +1,69 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_SIDEKIQ_RX_BLOCK_RING_H
+#define INCLUDED_SIDEKIQ_RX_BLOCK_RING_H
+
+#include "spsc_ring.h"
+#include <sidekiq_api.h>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace gr {
+namespace sidekiq {
+
+/*
+ * rx_block_ring
+ *
+ * Single producer / single consumer ring (see spsc_ring) of preallocated DMA block
+ * sized slots.  The capture thread copies each block returned by skiq_receive()
+ * into the next free slot, work() reads them back out in the same order.
+ *
+ * A slot returned by front() stays valid until pop() is called, which mirrors
+ * the "valid until the next skiq_receive()" contract of libsidekiq.
+ */
+class rx_block_ring
+{
+public:
+    rx_block_ring(uint32_t num_slots, uint32_t slot_size_bytes);
+
+    /* producer side, returns false if the ring is full and the block was dropped */
+    bool push(uint32_t card_index, skiq_rx_hdl_t hdl, const skiq_rx_block_t *p_block, uint32_t length_bytes);
+
+    /* consumer side, returns false if the ring is empty */
+    bool front(uint32_t *p_card_index, skiq_rx_hdl_t *p_hdl, skiq_rx_block_t **pp_block, uint32_t *p_length_bytes);
+    void pop() { slots.pop(); }
+    bool empty() const { return slots.empty(); }
+
+    /* only call when neither side is running */
+    void reset();
+
+    uint32_t capacity() const { return slots.capacity(); }
+    uint64_t dropped() const { return drop_count.load(std::memory_order_relaxed); }
+
+private:
+    struct slot_info {
+        uint64_t *p_data;          /* this slot's part of storage, set up once */
+        uint32_t card_index;
+        skiq_rx_hdl_t hdl;
+        uint32_t length_bytes;
+    };
+
+    uint32_t slot_words{};
+
+    /* uint64_t storage keeps every slot aligned for the skiq_rx_block_t header */
+    std::vector<uint64_t> storage;
+    spsc_ring<slot_info> slots;
+
+    alignas(64) std::atomic<uint64_t> drop_count{};
+};
+
+} // namespace sidekiq
+} // namespace gr
+
+#endif /* INCLUDED_SIDEKIQ_RX_BLOCK_RING_H */
@@ -0,0 +1,167 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "rx_dispatcher.h"
+#include <algorithm>
+#include <cerrno>
+
+#define DISPATCH_TRANSFER_TIMEOUT   100000   // us, bounds how long the card thread holds off stop()
+
+namespace gr {
+namespace sidekiq {
+
+rx_dispatcher &rx_dispatcher::instance()
+{
+    static rx_dispatcher dispatcher;
+
+    return dispatcher;
+}
+
+int32_t rx_dispatcher::subscribe(uint8_t card, skiq_rx_hdl_t hdl, const void *owner)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (card >= SKIQ_MAX_NUM_CARDS || hdl >= skiq_rx_hdl_end)
+    {
+        return -EINVAL;
+    }
+
+    if (state[card].owner[hdl] != nullptr && state[card].owner[hdl] != owner)
+    {
+        return -EBUSY;
+    }
+    state[card].owner[hdl] = owner;
+
+    return 0;
+}
+
+void rx_dispatcher::unsubscribe(uint8_t card, skiq_rx_hdl_t hdl, const void *owner)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (card < SKIQ_MAX_NUM_CARDS && hdl < skiq_rx_hdl_end && state[card].owner[hdl] == owner)
+    {
+        state[card].owner[hdl] = nullptr;
+    }
+}
+
+uint32_t rx_dispatcher::owners(uint8_t card)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    const void *seen[skiq_rx_hdl_end]{};
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < skiq_rx_hdl_end; i++)
+    {
+        const void *owner = state[card].owner[i];
+
+        if (owner != nullptr && std::find(seen, seen + count, owner) == (seen + count))
+        {
+            seen[count++] = owner;
+        }
+    }
+
+    return count;
+}
+
+uint32_t rx_dispatcher::users(uint8_t card)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    return state[card].users;
+}
+
+void rx_dispatcher::start(uint8_t card, const skiq_rx_hdl_t *p_handles, uint8_t num_handles,
+        rx_block_ring *p_ring, uint32_t card_index)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    card_state &cs = state[card];
+
+    {
+        std::lock_guard<std::mutex> route_guard(cs.route_lock);
+        for (uint8_t i = 0; i < num_handles; i++)
+        {
+            cs.routes[p_handles[i]].ring = p_ring;
+            cs.routes[p_handles[i]].card_index = card_index;
+        }
+    }
+
+    if (cs.users++ == 0)
+    {
+        cs.status = 0;
+        cs.running = true;
+        cs.thread = std::thread(&rx_dispatcher::dispatch_loop, this, card);
+    }
+}
+
+void rx_dispatcher::stop(uint8_t card, const skiq_rx_hdl_t *p_handles, uint8_t num_handles)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    card_state &cs = state[card];
+
+    {
+        std::lock_guard<std::mutex> route_guard(cs.route_lock);
+        for (uint8_t i = 0; i < num_handles; i++)
+        {
+            cs.routes[p_handles[i]].ring = nullptr;
+        }
+    }
+
+    if (cs.users > 0 && --cs.users == 0)
+    {
+        cs.running = false;
+        if (cs.thread.joinable())
+        {
+            cs.thread.join();
+        }
+    }
+}
+
+/*
+ * dispatch_loop
+ *
+ * The card thread.  It waits in the driver for the next block, so it does not spin when the
+ * card is quiet, and drops blocks of handles nobody routes.  A full ring drops the block, the
+ * RX block that owns it sees the gap as a timestamp overrun.
+ */
+void rx_dispatcher::dispatch_loop(uint8_t card)
+{
+    card_state &cs = state[card];
+    skiq_rx_status_t status{};
+    skiq_rx_hdl_t hdl{};
+    skiq_rx_block_t *p_rx_block{};
+    uint32_t data_length_bytes{};
+
+    skiq_set_rx_transfer_timeout(card, DISPATCH_TRANSFER_TIMEOUT);
+
+    while (cs.running.load(std::memory_order_relaxed) == true)
+    {
+        status = skiq_receive(card, &hdl, &p_rx_block, &data_length_bytes);
+        if (status == skiq_rx_status_success)
+        {
+            std::lock_guard<std::mutex> route_guard(cs.route_lock);
+
+            if (hdl < skiq_rx_hdl_end && cs.routes[hdl].ring != nullptr)
+            {
+                cs.routes[hdl].ring->push(cs.routes[hdl].card_index, hdl, p_rx_block, data_length_bytes);
+            }
+        }
+        else if (status == skiq_rx_status_no_data || status == skiq_rx_status_error_overrun)
+        {
+            /* nothing yet, or a gap the owners see in the timestamps */
+        }
+        else
+        {
+            /* every RX block on the card reports it from its own work() */
+            cs.status = status;
+            break;
+        }
+    }
+}
+
+} // namespace sidekiq
+} // namespace gr
@@ -0,0 +1,88 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_SIDEKIQ_RX_DISPATCHER_H
+#define INCLUDED_SIDEKIQ_RX_DISPATCHER_H
+
+#include "rx_block_ring.h"
+#include <sidekiq_api.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace gr {
+namespace sidekiq {
+
+/*
+ * rx_dispatcher
+ *
+ * skiq_receive() returns the next block of any handle streaming on a card, so two RX blocks
+ * on the same card can not both call it.  Each RX block claims its handles here, and when a
+ * card has more than one RX block, one thread per card drains skiq_receive() and copies each
+ * block into the ring of the RX block that owns the handle.  Each RX block then only reads its
+ * own rings, so independent flowgraph branches do not wait on each other.
+ *
+ * The card thread runs while at least one RX block on the card is started.
+ */
+class rx_dispatcher
+{
+public:
+    static rx_dispatcher &instance();
+
+    /* claim a handle for owner, -EBUSY if another block already has it */
+    int32_t subscribe(uint8_t card, skiq_rx_hdl_t hdl, const void *owner);
+    void unsubscribe(uint8_t card, skiq_rx_hdl_t hdl, const void *owner);
+
+    /* number of blocks that claimed a handle on the card */
+    uint32_t owners(uint8_t card);
+
+    /* number of blocks that are started on the card */
+    uint32_t users(uint8_t card);
+
+    /* route the handles into p_ring, tagged with card_index, and start the card thread if
+     * it is not running yet */
+    void start(uint8_t card, const skiq_rx_hdl_t *p_handles, uint8_t num_handles,
+            rx_block_ring *p_ring, uint32_t card_index);
+
+    /* stop routing the handles, the card thread stops after the last block on the card */
+    void stop(uint8_t card, const skiq_rx_hdl_t *p_handles, uint8_t num_handles);
+
+    /* 0, or the skiq_receive() failure that stopped the card thread */
+    int32_t status(uint8_t card) const { return state[card].status.load(); }
+
+private:
+    rx_dispatcher() = default;
+
+    struct route {
+        rx_block_ring *ring;
+        uint32_t card_index;
+    };
+
+    struct card_state {
+        const void *owner[skiq_rx_hdl_end];
+        uint32_t users;
+
+        /* taken by the card thread around each copy, so a ring is never used after stop() */
+        std::mutex route_lock;
+        route routes[skiq_rx_hdl_end];
+
+        std::thread thread;
+        std::atomic<bool> running;
+        std::atomic<int32_t> status;
+    };
+
+    void dispatch_loop(uint8_t card);
+
+    std::mutex lock;
+    card_state state[SKIQ_MAX_NUM_CARDS]{};
+};
+
+} // namespace sidekiq
+} // namespace gr
+
+#endif /* INCLUDED_SIDEKIQ_RX_DISPATCHER_H */
@@ -7,10 +7,14 @@
 
 
 #include "sidekiq_rx_impl.h"
+#include "iq_pack.h"
 #include <gnuradio/io_signature.h>
 #include <volk/volk.h>
 #include <boost/asio.hpp>
+#include <algorithm>
 #include <chrono>
+#include <pthread.h>
+#include <time.h>
 
 #define DEBUG_LEVEL "debug" //Can be debug, info, warning, error, critical
 
@@ -22,6 +26,8 @@ const pmt_t CONTROL_MESSAGE_PORT{pmt::string_to_symbol("command")};
 namespace gr {
 namespace sidekiq {
 
+static const char *rx_strategy_names[RX_STRATEGY_END] = { "poll", "blocking", "adaptive", "spin" };
+
 using output_type = float;
 sidekiq_rx::sptr sidekiq_rx::make(
         int input_card,
@@ -36,7 +42,16 @@ sidekiq_rx::sptr sidekiq_rx::make(
         int trigger_src,
         int pps_source,
         int cal_mode,
-        int cal_type) 
+        int cal_type,
+        int capture_blocks,
+        int output_format,
+        int rx_strategy,
+        int stream_mode,
+        int packed_mode,
+        int overrun_mode,
+        int port3_handle,
+        int port4_handle,
+        const std::vector<int> &extra_cards) 
 {
   return gnuradio::make_block_sptr<sidekiq_rx_impl>(
           input_card,
@@ -51,7 +66,16 @@ sidekiq_rx::sptr sidekiq_rx::make(
           trigger_src,
           pps_source,
           cal_mode,
-          cal_type);
+          cal_type,
+          capture_blocks,
+          output_format,
+          rx_strategy,
+          stream_mode,
+          packed_mode,
+          overrun_mode,
+          port3_handle,
+          port4_handle,
+          extra_cards);
 }
 
 sidekiq_rx_impl::sidekiq_rx_impl(
@@ -67,10 +91,19 @@ sidekiq_rx_impl::sidekiq_rx_impl(
         int local_trigger_src,
         int local_pps_source,
         int cal_mode,
-        int cal_type) 
+        int cal_type,
+        int capture_blocks,
+        int output_format,
+        int rx_strategy,
+        int local_stream_mode,
+        int packed_mode,
+        int overrun_mode,
+        int port3_handle,
+        int port4_handle,
+        const std::vector<int> &extra_cards) 
     : gr::sync_block("sidekiq_rx", gr::io_signature::make(0, 0, 0),
-                                   gr::io_signature::make(1 /* min outputs */, 2 /*max outputs */,
-                                            sizeof(gr_complex))) 
+                                   gr::io_signature::make(1 /* min outputs */, MAX_OUTPUTS /*max outputs */,
+                                            output_item_size_for(output_format))) 
 {
     std::string str;
 
@@ -85,14 +118,31 @@ sidekiq_rx_impl::sidekiq_rx_impl(
     uint8_t iq_resolution = 0;
     status_update_rate_in_samples = static_cast<size_t >(sample_rate * STATUS_UPDATE_RATE_SECONDS);
 
-    curr_rf_block_tag.key = pmt::intern("rf_timestamp");
-    curr_rf_block_tag.value = pmt::from_uint64(0);
+    for (uint32_t i = 0; i < MAX_OUTPUTS; i++)
+    {
+        ports[i].rf_block_tag.key = RF_TIMESTAMP_KEY;
+        ports[i].rf_block_tag.value = pmt::from_uint64(0);
+    }
+
+    if (overrun_mode == OVERRUN_MODE_TAG)
+    {
+        zero_fill = false;
+    }
+    else if (overrun_mode == OVERRUN_MODE_ZERO_FILL)
+    {
+        zero_fill = true;
+    }
+    else
+    {
+        d_logger->error( "Error: Invalid overrun mode {}" , overrun_mode);
+        throw std::runtime_error("Failure: overrun_mode");
+    }
 
     this->timestamp_tags = timestamp_tags;
+    this->output_sc16 = (output_format == OUTPUT_FORMAT_SC16);
+    this->output_item_size = output_item_size_for(output_format);
     card = input_card;
-    hdl1 = (skiq_rx_hdl_t) port1_handle;
     this->card = input_card;
-    this->hdl1 = (skiq_rx_hdl_t) port1_handle;
 
 
 
@@ -136,60 +186,164 @@ sidekiq_rx_impl::sidekiq_rx_impl(
 
     d_logger->debug("trigger {}, pps_source {}", this->trigger_src, this->pps_source);
 
-    /* determine if we are in dual port */
-    if (port2_handle < skiq_rx_hdl_end)
+    /* the extra cards stream the same handles as the first card */
+    if (extra_cards.size() >= MAX_CARDS)
     {
-        this->dual_port = true;
-        this->hdl2 = (skiq_rx_hdl_t) port2_handle;
+        d_logger->error( "Error: {} extra cards given, at most {} are supported", extra_cards.size(), MAX_CARDS - 1);
+        throw std::runtime_error("Failure: extra_cards");
     }
-    else
+
+    cards[0] = card;
+    num_cards = 1;
+    for (auto extra_card : extra_cards)
     {
-        this->hdl2 = skiq_rx_hdl_end;
-        this->dual_port = false;
+        if (extra_card < 0 || extra_card >= SKIQ_MAX_NUM_CARDS || 
+                std::find(cards, cards + num_cards, extra_card) != (cards + num_cards))
+        {
+            d_logger->error( "Error: Invalid or duplicate card {}" , extra_card);
+            throw std::runtime_error("Failure: extra_cards");
+        }
+        cards[num_cards++] = static_cast<uint8_t>(extra_card);
     }
 
-    /* initialize libsidekiq */
-    status = skiq_init(skiq_xport_type_pcie, skiq_xport_init_level_full, &card, 1);
-    if (status != 0)
+    /* multiple cards only start on the same sample when they share a trigger */
+    if (num_cards > 1 && trigger_src == skiq_trigger_src_immediate)
     {
-        if (status != -EEXIST)
+        d_logger->warn("Warning: {} cards started with an immediate trigger will not be sample aligned", num_cards);
+    }
+
+    /* determine how many ports we are streaming, unused ports are NO_HANDLE */
+    int port_handles[MAX_PORT] = {port1_handle, port2_handle, port3_handle, port4_handle};
+
+    for (uint32_t c = 0; c < MAX_CARDS; c++)
+    {
+        for (uint32_t i = 0; i < skiq_rx_hdl_end; i++)
         {
-            d_logger->error( "Error: unable to initialize libsidekiq with status {}", status);
-            throw std::runtime_error("Failure: skiq_init");
+            hdl_to_port[c][i] = -1;
         }
-        else
+    }
+
+    num_ports = 0;
+    for (uint32_t c = 0; c < num_cards; c++)
+    {
+        for (uint32_t i = 0; i < MAX_PORT; i++)
         {
-            d_logger->info("Info: If not running Transceive Mode, then this is an error");
-            rx_second = true;
+            if (port_handles[i] == NO_HANDLE)
+            {
+                continue;
+            }
+
+            if (port_handles[i] < 0 || port_handles[i] >= skiq_rx_hdl_end || hdl_to_port[c][port_handles[i]] != -1)
+            {
+                d_logger->error( "Error: Invalid or duplicate handle {} for port {}" , port_handles[i], i + 1);
+                throw std::runtime_error("Failure: port_handle");
+            }
+
+            /* the outputs are numbered card by card, in the order the handles are given */
+            hdl_to_port[c][port_handles[i]] = num_ports;
+            ports[num_ports].card = cards[c];
+            ports[num_ports].hdl = (skiq_rx_hdl_t) port_handles[i];
+            num_ports++;
         }
     }
+
+    if (num_ports == 0)
+    {
+        d_logger->error( "Error: No RX handle given");
+        throw std::runtime_error("Failure: port_handle");
+    }
+    d_logger->info("Info: RX streaming on {} port(s) of {} card(s)", num_ports, num_cards);
+
+    if (local_stream_mode == STREAM_MODE_HIGH_TPUT)
+    {
+        this->stream_mode = skiq_rx_stream_mode_high_tput;
+    }
+    else if (local_stream_mode == STREAM_MODE_LOW_LATENCY)
+    {
+        this->stream_mode = skiq_rx_stream_mode_low_latency;
+    }
+    else if (local_stream_mode == STREAM_MODE_BALANCED)
+    {
+        this->stream_mode = skiq_rx_stream_mode_balanced;
+    }
+    else
+    {
+        d_logger->error( "Error: Invalid stream mode {}" , local_stream_mode);
+        throw std::runtime_error("Failure: stream_mode");
+    }
+
+    if (capture_blocks < CAPTURE_DISABLED)
+    {
+        d_logger->error( "Error: invalid capture_blocks {}", capture_blocks);
+        throw std::runtime_error("Failure: capture_blocks");
+    }
+
+    if (rx_strategy < RX_STRATEGY_POLL || rx_strategy >= RX_STRATEGY_END)
+    {
+        d_logger->error( "Error: invalid rx_strategy {}", rx_strategy);
+        throw std::runtime_error("Failure: rx_strategy");
+    }
+    this->rx_strategy = rx_strategy;
+    d_logger->info("Info: RX receive strategy {}", rx_strategy_names[rx_strategy]);
+
+    /* every argument is checked by now.  If anything below throws the destructor never runs,
+     * so the guard gives the cards and handles back */
+    card_guard<sidekiq_rx_impl> guard(this, &sidekiq_rx_impl::release_cards);
+
+    /* enable the cards, libsidekiq is shared with any other sidekiq block in the process */
+    status = card_manager::instance().acquire(cards, num_cards, &rx_second);
+    if (status != 0)
+    {
+        d_logger->error( "Error: unable to initialize libsidekiq with status {}", status);
+        throw std::runtime_error("Failure: skiq_init");
+    }
+    libsidekiq_init = true;
+    if (rx_second == true)
+    {
+        d_logger->info("Info: sharing the card with another sidekiq block");
+    }
     else
     {
-        libsidekiq_init = true;
         d_logger->info("Info: libsidkiq initialized successfully");
     }
 
+    /* a handle belongs to one RX block, other blocks on the card can stream the rest */
+    for (uint32_t i = 0; i < num_ports; i++)
+    {
+        status = rx_dispatcher::instance().subscribe(ports[i].card, ports[i].hdl, this);
+        if (status != 0)
+        {
+            d_logger->error( "Error: handle {} on card {} is already used by another RX block", 
+                    ports[i].hdl, ports[i].card);
+            throw std::runtime_error("Failure: port_handle");
+        }
+    }
+
+    /* the radio settings are staged here and written once, in order, by start() */
     set_rx_sample_rate(sample_rate);
     set_rx_bandwidth(bandwidth);
 
     /* configure the 1PPS source for each of the cards */
-    if ( pps_source != skiq_1pps_source_unavailable )
+    for (uint32_t c = 0; (c < num_cards) && (pps_source != skiq_1pps_source_unavailable); c++)
     {
-        status = skiq_write_1pps_source( card, pps_source );
+        status = skiq_write_1pps_source( cards[c], pps_source );
         if ( status != 0 )
         {
-            d_logger->error( "Error: unable to write 1pps source with status {}", status);
+            d_logger->error( "Error: unable to write 1pps source on card {} with status {}", cards[c], status);
             throw std::runtime_error("Failure: skiq_write_1pps_source");
         }
         else
         {
-            d_logger->info("Info: configured 1PPS source to {}", pps_source);
+            d_logger->info("Info: configured 1PPS source on card {} to {}", cards[c], pps_source);
         }
-      }
+    }
 
 
 #ifdef COUNTER
-    skiq_write_rx_data_src(card, hdl1, skiq_data_src_counter);
+    for (uint32_t i = 0; i < num_ports; i++)
+    {
+        skiq_write_rx_data_src(ports[i].card, ports[i].hdl, skiq_data_src_counter);
+    }
 #endif
 
     /* calculate the adc scaling */
@@ -204,68 +358,124 @@ sidekiq_rx_impl::sidekiq_rx_impl(
 
 
     /* if A2 or B2 is used, we need to set the channel mode to dual */
-    if (hdl1 == skiq_rx_hdl_A2 || hdl1 == skiq_rx_hdl_B2 || 
-            hdl2 == skiq_rx_hdl_A2 || hdl2 == skiq_rx_hdl_B2)
+    bool dual_chan = false;
+    for (uint32_t i = 0; i < num_ports; i++)
+    {
+        if (ports[i].hdl == skiq_rx_hdl_A2 || ports[i].hdl == skiq_rx_hdl_B2)
+        {
+            dual_chan = true;
+        }
+    }
+
+    /* packed mode moves 12-bit samples as 24 bits over the bus, they are unpacked in get_new_block() */
+    this->packed_mode = (packed_mode != 0);
+
+    /* the channel and pack modes are card wide, the card manager keeps RX and TX in agreement.
+     * It also switched the cards to I/Q order when they were enabled */
+    for (uint32_t c = 0; c < num_cards; c++)
     {
-        status = skiq_write_chan_mode(card, skiq_chan_mode_dual);
+        status = card_manager::instance().set_chan_mode(cards[c], dual_chan);
         if (status != 0)
         {
             d_logger->error( "Error: unable to configure TX channel mode with status {}", status);
             throw std::runtime_error("Failure: skiq_write_chan_mode");
         }
+        if (dual_chan == true)
+        {
+            num_dual_cards = c + 1;
+        }
+
+        status = card_manager::instance().set_pack_mode(cards[c], 
+                this->packed_mode ? SIDEKIQ_IQ_PACK_MODE_PACKED : SIDEKIQ_IQ_PACK_MODE_UNPACKED);
+        if (status != 0)
+        {
+            d_logger->error( "Error: unable to set iq pack mode to {} with status {}, "
+                    "it has to match any other block on card {}", packed_mode, status, cards[c]);
+            throw std::runtime_error("Failure: skiq_write_iq_pack_mode");
+        }
     }
-    else {
-        status = skiq_write_chan_mode(card, skiq_chan_mode_single);
+
+    /* the stream mode determines the DMA block size, it can only change while not streaming */
+    for (uint32_t c = 0; c < num_cards; c++)
+    {
+        status = skiq_write_rx_stream_mode(cards[c], this->stream_mode);
         if (status != 0)
         {
-            d_logger->error( "Error: unable to configure TX channel mode with status {}", status);
-            throw std::runtime_error("Failure: skiq_write_chan_mode");
+            d_logger->error( "Error: unable to set RX stream mode {} with status {}", local_stream_mode, status);
+            throw std::runtime_error("Failure: skiq_write_rx_stream_mode");
         }
     }
 
-    /* always assume unpacked */
-    status = skiq_write_iq_pack_mode(card, SIDEKIQ_IQ_PACK_MODE_UNPACKED);
-    if (status != 0)
+    /* the block size includes the header, each payload word is one sample unless packed */
+    status = skiq_read_rx_block_size(card, this->stream_mode);
+    if (status < 0)
     {
-        d_logger->error( "Error: unable to set iq pack mode to unpacked with status {}", status);
-        throw std::runtime_error("Failure: skiq_write_iq_pack_mode");
+        d_logger->error( "Error: unable to read RX block size with status {}", status);
+        throw std::runtime_error("Failure: skiq_read_rx_block_size");
     }
+    rx_block_size = static_cast<int32_t>((status - SKIQ_RX_HEADER_SIZE_IN_BYTES) / sizeof(uint32_t));
 
-    /* by default all cards are in Q/I order we want it to be I/Q so switch it */
-    status = skiq_write_iq_order_mode(card, skiq_iq_order_iq) ;
-    if (status != 0)
+    if (this->packed_mode == true)
+    {
+        rx_block_size = packed_samples_in_words(rx_block_size);
+        for (uint32_t i = 0; i < num_ports; i++)
+        {
+            ports[i].unpack_buffer.resize(rx_block_size * IQ_SHORT_COUNT);
+        }
+    }
+    d_logger->info("Info: RX stream mode {}, {} samples per block", local_stream_mode, rx_block_size);
+
+    /* with several ports, a block can arrive for a port that can not take it yet */
+    if (num_ports > 1)
     {
-          d_logger->error( "Error: unable to set iq order mode to iq with status {} ", status);
-          throw std::runtime_error("Failure: skiq_write_iq_pack_mode");
+        for (uint32_t i = 0; i < num_ports; i++)
+        {
+            ports[i].backlog.reset(new rx_block_ring(PORT_BACKLOG_BLOCKS, SKIQ_MAX_RX_BLOCK_SIZE_IN_BYTES));
+            ports[i].carry_buffer.resize(rx_block_size * IQ_SHORT_COUNT);
+        }
     }
 
     /* support two messages */
+    timed_commands.reset(new timed_command_queue(TIMED_COMMAND_DEPTH));
     message_port_register_in(CONTROL_MESSAGE_PORT);
     set_msg_handler(CONTROL_MESSAGE_PORT, [this](pmt::pmt_t msg) { this->handle_control_message(msg); });
 
-    /* set the rest of the parameters */
+    /* stage the rest of the parameters */
     set_rx_frequency(frequency);
+    /* in manual mode this writes gain_index too */
     set_rx_gain_mode(gain_mode);
 
-    if (gain_mode == skiq_rx_gain_manual)
-    {
-        set_rx_gain_index(gain_index);
-    }
-
     set_rx_cal_mode(cal_mode);
     set_rx_cal_type(cal_type);
 
 #ifdef COUNTER
-    skiq_write_rx_data_src(card, hdl1, skiq_data_src_counter);
+    for (uint32_t i = 0; i < num_ports; i++)
+    {
+        skiq_write_rx_data_src(ports[i].card, ports[i].hdl, skiq_data_src_counter);
+    }
 #endif
 
     /* we need gnuradio to send in buffers of an integer multiple of our DMA block sizes */
-    gr::block::set_min_noutput_items(DATA_MAX_BUFFER_SIZE);
-    gr::block::set_output_multiple(DATA_MAX_BUFFER_SIZE);
+    gr::block::set_min_noutput_items(rx_block_size);
+    gr::block::set_output_multiple(rx_block_size);
 
-    last_time = Clock::now();
+    /* in low latency mode hand every block downstream as soon as it arrives */
+    if (this->stream_mode == skiq_rx_stream_mode_low_latency)
+    {
+        gr::block::set_max_noutput_items(rx_block_size);
+    }
+
+    /* optionally receive on a dedicated thread so a stalled flowgraph does not stall skiq_receive */
+    this->capture_blocks = capture_blocks;
+    if (capture_blocks != CAPTURE_DISABLED)
+    {
+        capture_ring.reset(new rx_block_ring(capture_blocks, SKIQ_MAX_RX_BLOCK_SIZE_IN_BYTES));
+        d_logger->info("Info: RX capture ring of {} blocks", capture_ring->capacity());
+    }
 
+    last_time = Clock::now();
 
+    guard.dismiss();
 }
 
 
@@ -280,21 +490,82 @@ sidekiq_rx_impl::~sidekiq_rx_impl()
         rx_streaming = false;
     }
 
+    release_cards();
+}
+
+/*
+ * release_cards
+ *
+ * Gives back the handles this block claimed, its dual channel requests and its reference to
+ * the cards.  What it never claimed is left alone, so this is safe part way through the
+ * constructor.
+ */
+void sidekiq_rx_impl::release_cards()
+{
+    for (uint32_t i = 0; i < num_ports; i++)
+    {
+        rx_dispatcher::instance().unsubscribe(ports[i].card, ports[i].hdl, this);
+    }
+
+    for (uint32_t c = 0; c < num_dual_cards; c++)
+    {
+        card_manager::instance().release_dual_chan(cards[c]);
+    }
+    num_dual_cards = 0;
+
+    /* libsidekiq only exits when the last block using it lets go */
     if (libsidekiq_init == true)
     {
-        skiq_exit();
+        card_manager::instance().release(cards, num_cards);
         libsidekiq_init = false;
     }
 }
 
 
 
+/* 
+ * the output signature has to be known before the constructor body runs 
+ */
+size_t sidekiq_rx_impl::output_item_size_for(int output_format)
+{
+    if (output_format == OUTPUT_FORMAT_FC32)
+    {
+        return sizeof(gr_complex);
+    }
+    else if (output_format == OUTPUT_FORMAT_SC16)
+    {
+        return sizeof(int16_t) * IQ_SHORT_COUNT;
+    }
+
+    throw std::runtime_error("Failure: invalid output_format");
+}
+
 double sidekiq_rx_impl::get_double_from_pmt_dict(pmt_t dict, pmt_t key, pmt_t not_found = pmt::PMT_NIL) {
     auto message_value = pmt::dict_ref(dict, key, not_found);
 
     return pmt::to_double(message_value);
 }
 
+/*
+ * rf_timestamps are 64 bit sample counts, a double only holds them exactly up to 2^53 so 
+ * integer values are read as integers
+ */
+uint64_t sidekiq_rx_impl::get_uint64_from_pmt_dict(pmt_t dict, pmt_t key)
+{
+    auto message_value = pmt::dict_ref(dict, key, pmt::PMT_NIL);
+
+    if (pmt::is_uint64(message_value))
+    {
+        return pmt::to_uint64(message_value);
+    }
+    else if (pmt::is_integer(message_value))
+    {
+        return static_cast<uint64_t>(pmt::to_long(message_value));
+    }
+
+    return static_cast<uint64_t>(pmt::to_double(message_value));
+}
+
 /*
  * Handle control messages
  *
@@ -302,6 +573,7 @@ double sidekiq_rx_impl::get_double_from_pmt_dict(pmt_t dict, pmt_t key, pmt_t no
 void sidekiq_rx_impl::handle_control_message(pmt_t msg) 
 {
     d_logger->debug("in handle_control_message");
+    std::lock_guard<std::recursive_mutex> guard(config_mutex);
 
     // pmt_dict is a subclass of pmt_pair. Make sure we use pmt_pair!
     // Old behavior was that these checks were interchangeable. Be aware of this change!
@@ -326,22 +598,46 @@ void sidekiq_rx_impl::handle_control_message(pmt_t msg)
          return;
      }
 
-    if (pmt::dict_has_key(msg, LO_FREQ_KEY)) 
+    /* while streaming, lo_freq and gain are applied by work() so the change is ordered with
+     * the samples and tagged.  A "time" key holds them until that rf_timestamp */
+    bool tuning = pmt::dict_has_key(msg, LO_FREQ_KEY) || pmt::dict_has_key(msg, GAIN_KEY);
+    bool timed = pmt::dict_has_key(msg, TIME_KEY);
+    if (tuning == true && rx_streaming == true)
+    {
+        queue_tuning_command(msg);
+    }
+    else if (tuning == true && timed == true)
+    {
+        d_logger->warn("Warning: not streaming, the time of the command is ignored");
+    }
+
+    /* the time only applies to lo_freq and gain */
+    if (timed == true && (pmt::dict_has_key(msg, RATE_KEY) || pmt::dict_has_key(msg, BANDWIDTH_KEY)))
+    {
+        d_logger->warn("Warning: rate and bandwidth can not be timed, they are applied now");
+    }
+
+    if (pmt::dict_has_key(msg, LO_FREQ_KEY) && rx_streaming == false) 
     {
         set_rx_frequency(get_double_from_pmt_dict(msg, LO_FREQ_KEY));
     }
 
-    if (pmt::dict_has_key(msg, RATE_KEY)) 
+    /* a rate and a bandwidth in the same message are written together */
+    if (pmt::dict_has_key(msg, RATE_KEY) && pmt::dict_has_key(msg, BANDWIDTH_KEY)) 
+    {
+        write_rate_and_bandwidth(static_cast<uint32_t>(get_double_from_pmt_dict(msg, RATE_KEY)),
+                static_cast<uint32_t>(get_double_from_pmt_dict(msg, BANDWIDTH_KEY)));
+    }
+    else if (pmt::dict_has_key(msg, RATE_KEY)) 
     {
         set_rx_sample_rate(get_double_from_pmt_dict(msg, RATE_KEY));
     }
-
-    if (pmt::dict_has_key(msg, BANDWIDTH_KEY)) 
+    else if (pmt::dict_has_key(msg, BANDWIDTH_KEY)) 
     {
         set_rx_bandwidth(get_double_from_pmt_dict(msg, BANDWIDTH_KEY));
     }
 
-    if (pmt::dict_has_key(msg, GAIN_KEY)) 
+    if (pmt::dict_has_key(msg, GAIN_KEY) && rx_streaming == false) 
     {
         set_rx_gain_index(get_double_from_pmt_dict(msg, GAIN_KEY));
     }
@@ -349,6 +645,40 @@ void sidekiq_rx_impl::handle_control_message(pmt_t msg)
 
 }
 
+/*
+ * queue_tuning_command
+ *
+ * Hands the lo_freq and gain of a control message to work().  Commands are applied in the
+ * order they are sent, a command with a time holds back the ones sent after it.
+ */
+void sidekiq_rx_impl::queue_tuning_command(pmt_t msg)
+{
+    timed_command_queue::command cmd{};
+
+    if (pmt::dict_has_key(msg, TIME_KEY))
+    {
+        cmd.timestamp = get_uint64_from_pmt_dict(msg, TIME_KEY);
+    }
+
+    if (pmt::dict_has_key(msg, LO_FREQ_KEY))
+    {
+        cmd.flags |= timed_command_queue::SET_FREQUENCY;
+        cmd.frequency = static_cast<uint64_t>(get_double_from_pmt_dict(msg, LO_FREQ_KEY));
+    }
+
+    if (pmt::dict_has_key(msg, GAIN_KEY))
+    {
+        cmd.flags |= timed_command_queue::SET_GAIN;
+        cmd.gain_index = static_cast<int32_t>(get_double_from_pmt_dict(msg, GAIN_KEY));
+    }
+
+    if (timed_commands->push(cmd) == false)
+    {
+        d_logger->error("Error: {} commands already waiting, the command at rf_timestamp {} is dropped",
+                TIMED_COMMAND_DEPTH, cmd.timestamp);
+    }
+}
+
 /* 
  * start streaming
  * 
@@ -362,42 +692,185 @@ bool sidekiq_rx_impl::start()
 
     d_logger->debug("in start");
 
-    status = skiq_reset_timestamps(card);
-    if (status != 0)
+    auto start_time = std::chrono::steady_clock::now();
+    apply_radio_config();
+
+    /* every block has claimed its handles by now, if another RX block shares one of the cards
+     * then skiq_receive() is left to the rx_dispatcher */
+    dispatched = false;
+    for (uint32_t c = 0; c < num_cards; c++)
+    {
+        if (rx_dispatcher::instance().owners(cards[c]) > 1)
+        {
+            dispatched = true;
+        }
+    }
+
+    for (uint32_t c = 0; c < num_cards; c++)
+    {
+        /* the other blocks already streaming on the card keep their timestamps */
+        if (dispatched == true && rx_dispatcher::instance().users(cards[c]) > 0)
+        {
+            continue;
+        }
+
+        /* several cards on a 1PPS trigger reset their timestamps on the same edge */
+        if (num_cards > 1 && trigger_src == skiq_trigger_src_1pps)
+        {
+            status = skiq_write_timestamp_reset_on_1pps(cards[c], 0);
+        }
+        else
+        {
+            status = skiq_reset_timestamps(cards[c]);
+        }
+        if (status != 0)
+        {
+            d_logger->error( "Error: could not reset timestamps on card {}, status {}", cards[c], status);
+            throw std::runtime_error("Failure: skiq_reset_timestamps");
+        }
+    }
+
+    /* only the blocking strategy waits in the driver, adaptive switches over on its own */
+    adaptive_blocking = false;
+    adaptive_spinning = false;
+    if (dispatched == true)
+    {
+        /* the card threads of the rx_dispatcher own the transfer timeout */
+    }
+    else if (rx_strategy == RX_STRATEGY_BLOCKING)
+    {
+        set_transfer_timeout(RX_TRANSFER_TIMEOUT);
+    }
+    else
     {
-        d_logger->error( "Error: could not reset timestamps, status {}", status);
-        throw std::runtime_error("Failure: skiq_reset_timestamps");
+        set_transfer_timeout(RX_TRANSFER_NO_WAIT);
     }
+    cpu_report_valid = false;
+    next_card = 0;
 
-    handles[0] = hdl1;
-    nrhandles = 1;
+    last_backlog_dropped = 0;
 
-    if (dual_port == true)
+    /* the timestamps were reset, so the next block on each port starts the overrun checks over */
+    for (uint32_t i = 0; i < num_ports; i++)
     {
-        handles[1] = hdl2;
-        nrhandles = 2;
+        ports[i].first_block = true;
+        ports[i].fill_samples_left = 0;
+        ports[i].overrun_tag_pending = false;
+        ports[i].rf_tag_pending = false;
+        ports[i].curr_block_samples_left = 0;
+        ports[i].block_in_receive_memory = false;
+        ports[i].backlog_slot_held = false;
+        if (ports[i].backlog)
+        {
+            ports[i].backlog->reset();
+        }
+        ports[i].setting_tags.reset();
     }
 
-    status = skiq_start_rx_streaming_multi_on_trigger(card, handles, nrhandles, trigger_src, 0);
-    if ( status != 0 )
+    /* the message handler queues commands from its own thread once rx_streaming is set, the
+     * queue may only be reset before that */
+    timed_commands->reset();
+
+    /* with several cards, nothing is output until every port can start on the same rf_timestamp */
+    align_pending = (num_cards > 1);
+    align_timestamp = 0;
+
+    /* start all the ports of a card together so their timestamps line up */
+    for (uint32_t c = 0; c < num_cards; c++)
     {
-       d_logger->error( "Error: could not start RX streaming on hdl1, status {}", status);
-       throw std::runtime_error("Failure: skiq_start_rx_streaming");
+        nrhandles = card_handles(c, handles);
+
+        status = skiq_start_rx_streaming_multi_on_trigger(cards[c], handles, nrhandles, trigger_src, 0);
+        if ( status != 0 )
+        {
+           d_logger->error( "Error: could not start RX streaming on card {}, status {}", cards[c], status);
+           throw std::runtime_error("Failure: skiq_start_rx_streaming");
+        }
     }
 
     rx_streaming = true;
 
-    /* tag indexes are absolute starting from the first sample out
-     * so they must be reset when starting a stream
-     */
-    last_tag_index[0] = 0;
-    last_tag_index[1] = 0;
+    if (dispatched == true)
+    {
+        for (uint32_t c = 0; c < num_cards; c++)
+        {
+            if (!dispatch_rings[c])
+            {
+                dispatch_rings[c].reset(new rx_block_ring(
+                            (capture_blocks != CAPTURE_DISABLED) ? capture_blocks : DISPATCH_RING_BLOCKS,
+                            SKIQ_MAX_RX_BLOCK_SIZE_IN_BYTES));
+            }
+            dispatch_rings[c]->reset();
+
+            nrhandles = card_handles(c, handles);
+            rx_dispatcher::instance().start(cards[c], handles, nrhandles, dispatch_rings[c].get(), c);
+        }
+        dispatch_slot_held = -1;
+        last_capture_dropped = 0;
+        d_logger->info("Info: RX card shared with another RX block, receiving through the dispatcher");
+    }
+    else if (capture_ring)
+    {
+        capture_ring->reset();
+        capture_slot_held = false;
+        last_capture_dropped = 0;
+        capture_status = 0;
+        capture_running = true;
+        capture_thread = std::thread(&sidekiq_rx_impl::capture_loop, this);
+        d_logger->info("Info: RX capture thread started");
+    }
 
-    d_logger->info("Info: RX streaming started");
+    d_logger->info("Info: RX streaming started in {:.1f} ms", 
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count());
 
     return block::start();
 }
 
+/*
+ * apply_radio_config
+ *
+ * Writes the settings staged since the constructor, once per handle.  Sample rate and 
+ * bandwidth go in a single write, the LO is tuned before the gain so the gain range read
+ * is for the final frequency.  After this the setters write to the card directly.
+ */
+void sidekiq_rx_impl::apply_radio_config()
+{
+    std::lock_guard<std::recursive_mutex> guard(config_mutex);
+
+    if (radio_configured == true)
+    {
+        return;
+    }
+
+    auto config_start = std::chrono::steady_clock::now();
+
+    /* the setters write to the card once this is set */
+    radio_configured = true;
+
+    try
+    {
+        set_rx_sample_rate(sample_rate);
+        set_rx_frequency(frequency);
+        /* in manual mode this writes gain_index too */
+        set_rx_gain_mode(gain_mode);
+
+        if (cal_enabled == true)
+        {
+            set_rx_cal_mode(cal_mode);
+            set_rx_cal_type(cal_type_setting);
+        }
+    }
+    catch (...)
+    {
+        /* a setter failed part way, the next start() writes every setting again */
+        radio_configured = false;
+        throw;
+    }
+
+    d_logger->info("Info: RX radio configured in {:.1f} ms", 
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - config_start).count());
+}
+
 /* 
  * stop streaming 
  * 
@@ -411,22 +884,28 @@ bool sidekiq_rx_impl::stop()
     
     d_logger->debug("in stop");
 
+    /* the capture thread must not call skiq_receive() once streaming is stopped */
+    stop_capture_thread();
+
     /* only call stop if we are actually streaming */
     if (rx_streaming == true)
     {
-        handles[0] = hdl1;
-        nrhandles = 1;
-        if (dual_port == true)
+        for (uint32_t c = 0; c < num_cards; c++)
         {
-            handles[1] = hdl2;
-            nrhandles = 2;
-        }
+            nrhandles = card_handles(c, handles);
 
-        status = skiq_stop_rx_streaming_multi_on_trigger(card, handles, nrhandles, trigger_src, 0);
-        if ( status != 0 )
-        {
-           d_logger->error( "Error: could not start RX streaming on hdl1, status {}", status);
-           throw std::runtime_error("Failure: skiq_start_rx_streaming");
+            /* the card thread stops with the last RX block on the card */
+            if (dispatched == true)
+            {
+                rx_dispatcher::instance().stop(cards[c], handles, nrhandles);
+            }
+
+            status = skiq_stop_rx_streaming_multi_on_trigger(cards[c], handles, nrhandles, trigger_src, 0);
+            if ( status != 0 )
+            {
+               d_logger->error( "Error: could not stop RX streaming on card {}, status {}", cards[c], status);
+               throw std::runtime_error("Failure: skiq_start_rx_streaming");
+            }
         }
         d_logger->info("Info: RX streaming stopped");
     }
@@ -444,36 +923,10 @@ bool sidekiq_rx_impl::stop()
  */
 void sidekiq_rx_impl::set_rx_sample_rate(double value) 
 {
-
-    int status = 0;
     d_logger->debug("in set_rx_sample_rate");
+    std::lock_guard<std::recursive_mutex> guard(config_mutex);
 
-    auto rate = static_cast<uint32_t>(value);
-    auto bw = static_cast<uint32_t>(this->bandwidth);
-
-    status = skiq_write_rx_sample_rate_and_bandwidth(card, hdl1, rate, bw); 
-    if (status != 0) 
-    {
-        d_logger->error( "Error: could not set sample_rate on hdl1, status {}, {}", 
-                status, strerror(abs(status)) );
-        throw std::runtime_error("Failure: set samplerate");
-    }
-
-    if (dual_port)
-    {
-        status = skiq_write_rx_sample_rate_and_bandwidth(card, hdl2, rate, bw); 
-        if (status != 0) 
-        {
-            d_logger->error( "Error: could not set sample_rate on hdl2, status {}, {}", 
-                    status, strerror(abs(status)) );
-            throw std::runtime_error("Failure: set samplerate");
-        }
-    }
-    d_logger->info("Info: sample_rate set to {}", rate);
-
-    this->sample_rate = rate;
-    this->bandwidth = bw;
-
+    write_rate_and_bandwidth(static_cast<uint32_t>(value), this->bandwidth);
 }
   
 /* 
@@ -484,37 +937,61 @@ void sidekiq_rx_impl::set_rx_sample_rate(double value)
  */
 void sidekiq_rx_impl::set_rx_bandwidth(double value) 
 {
-    int status = 0;
     d_logger->debug("in set_rx_bandwidth");
+    std::lock_guard<std::recursive_mutex> guard(config_mutex);
+
+    write_rate_and_bandwidth(this->sample_rate, static_cast<uint32_t>(value));
+}
 
-    auto rate = static_cast<uint32_t>(this->sample_rate);
-    auto bw = static_cast<uint32_t>(value);
+/*
+ * write_rate_and_bandwidth
+ *
+ * libsidekiq sets both in one call, so a rate and a bandwidth change in the same control
+ * message are written together.  A handle that already has both values is skipped.
+ */
+void sidekiq_rx_impl::write_rate_and_bandwidth(uint32_t rate, uint32_t bw)
+{
+    int status = 0;
+    uint32_t written = 0;
+    std::lock_guard<std::recursive_mutex> guard(config_mutex);
 
-    status = skiq_write_rx_sample_rate_and_bandwidth(card, hdl1, rate, bw); 
-    if (status != 0) 
+    /* before start() the setting is only staged, apply_radio_config() writes it */
+    if (radio_configured == false)
     {
-        d_logger->error("Error: could not set bandwidth {} on hdl1, status {}, {}", 
-                bw, status, strerror(abs(status)) );
-        throw std::runtime_error("Failure: set bandwidth");
+        this->sample_rate = rate;
+        this->bandwidth = bw;
         return;
     }
 
-    if (dual_port)
+    for (uint32_t i = 0; i < num_ports; i++)
     {
-        status = skiq_write_rx_sample_rate_and_bandwidth(card, hdl2, rate, bw); 
+        if (ports[i].hw_rate_valid == true && ports[i].hw_sample_rate == rate && ports[i].hw_bandwidth == bw)
+        {
+            continue;
+        }
+
+        /* if the write fails the handle is in an unknown state */
+        ports[i].hw_rate_valid = false;
+        status = skiq_write_rx_sample_rate_and_bandwidth(ports[i].card, ports[i].hdl, rate, bw); 
         if (status != 0) 
         {
-            d_logger->error("Error: could not set bandwidth {} on hdl2, status {}, {}", 
-                    bw, status, strerror(abs(status)) );
-            throw std::runtime_error("Failure: set bandwidth");
-            return;
+            d_logger->error( "Error: could not set sample_rate {} and bandwidth {} on hdl {}, status {}, {}", 
+                    rate, bw, ports[i].hdl, status, strerror(abs(status)) );
+            throw std::runtime_error("Failure: set samplerate");
         }
+        ports[i].hw_rate_valid = true;
+        ports[i].hw_sample_rate = rate;
+        ports[i].hw_bandwidth = bw;
+        written++;
+    }
+
+    if (written > 0)
+    {
+        d_logger->info("Info: sample_rate set to {}, bandwidth {}", rate, bw);
     }
-    d_logger->info("Info: bandwidth set to {}", bw);
 
     this->sample_rate = rate;
     this->bandwidth = bw;
-
 }
 
 /* 
@@ -526,32 +1003,44 @@ void sidekiq_rx_impl::set_rx_bandwidth(double value)
 void sidekiq_rx_impl::set_rx_frequency(double value) 
 {
     int status = 0;
+    uint32_t written = 0;
     d_logger->debug("in set_rx_frequency");
+    std::lock_guard<std::recursive_mutex> guard(config_mutex);
 
     auto freq = static_cast<uint64_t>(value);
 
-    status = skiq_write_rx_LO_freq(card, hdl1, freq);
-    if (status != 0) 
+    /* before start() the setting is only staged, apply_radio_config() writes it */
+    if (radio_configured == false)
     {
-        d_logger->error("Error: could not set frequency {} on hdl1, status {}, {}", 
-                freq, status, strerror(abs(status)) );
-        throw std::runtime_error("Failure: set frequency");
+        this->frequency = freq;
         return;
     }
 
-    if (dual_port)
+    for (uint32_t i = 0; i < num_ports; i++)
     {
-        status = skiq_write_rx_LO_freq(card, hdl2, freq);
+        if (ports[i].hw_frequency == freq)
+        {
+            continue;
+        }
+
+        ports[i].hw_frequency = 0;
+        gain_range_valid = false;
+        status = skiq_write_rx_LO_freq(ports[i].card, ports[i].hdl, freq);
         if (status != 0) 
         {
-            d_logger->error("Error: could not set frequency {} on hdl2, status {}, {}", 
-                    freq, status, strerror(abs(status)) );
+            d_logger->error("Error: could not set frequency {} on hdl {}, status {}, {}", 
+                    freq, ports[i].hdl, status, strerror(abs(status)) );
             throw std::runtime_error("Failure: set frequency");
             return;
         }
+        ports[i].hw_frequency = freq;
+        written++;
     }
 
-    d_logger->info("Info: frequency set to {}", freq);
+    if (written > 0)
+    {
+        d_logger->info("Info: frequency set to {}", freq);
+    }
 
     this->frequency = freq;
 }
@@ -565,36 +1054,54 @@ void sidekiq_rx_impl::set_rx_frequency(double value)
 void sidekiq_rx_impl::set_rx_gain_mode(double value) 
 {
     int status = 0;
+    uint32_t written = 0;
 
     d_logger->debug("in set_rx_gain_mode");
+    std::lock_guard<std::recursive_mutex> guard(config_mutex);
 
     auto gain_mode = static_cast<skiq_rx_gain_t>(value);
 
-    status = skiq_write_rx_gain_mode(card, hdl1, gain_mode);
-    if (status != 0) 
+    /* before start() the setting is only staged, apply_radio_config() writes it */
+    if (radio_configured == false)
     {
-        d_logger->error("Error: write_rx_gain_mode failed on hdl1, status {}, {} ", 
-                status, strerror(abs(status)) );
-        throw std::runtime_error("Failure: set write_rx_gain_mode");
+        this->gain_mode = gain_mode;
         return;
     }
 
-    if (dual_port)
+    for (uint32_t i = 0; i < num_ports; i++)
     {
-        status = skiq_write_rx_gain_mode(card, hdl2, gain_mode);
+        if (ports[i].hw_gain_mode == gain_mode)
+        {
+            continue;
+        }
+
+        /* AGC changes the gain on its own, so the last gain written is no longer known */
+        ports[i].hw_gain_mode = -1;
+        ports[i].hw_gain = -1;
+        status = skiq_write_rx_gain_mode(ports[i].card, ports[i].hdl, gain_mode);
         if (status != 0) 
         {
-            d_logger->error("Error: write_rx_gain_mode failed on hdl2, status {}, {}", 
-                    status, strerror(abs(status)) );
+            d_logger->error("Error: write_rx_gain_mode failed on hdl {}, status {}, {}", 
+                    ports[i].hdl, status, strerror(abs(status)) );
             throw std::runtime_error("Failure: set write_rx_gain_mode");
             return;
         }
+        ports[i].hw_gain_mode = gain_mode;
+        written++;
     }
 
-    d_logger->info("Info: gain_mode set to {}", gain_mode);
+    if (written > 0)
+    {
+        d_logger->info("Info: gain_mode set to {}", gain_mode);
+    }
 
     this->gain_mode = gain_mode;
-    
+
+    /* back in manual mode the card holds whatever gain AGC left, so write the manual gain */
+    if (written > 0 && gain_mode == skiq_rx_gain_manual)
+    {
+        set_rx_gain_index(this->gain_index);
+    }
 }
 
 /* 
@@ -606,24 +1113,25 @@ void sidekiq_rx_impl::set_rx_gain_mode(double value)
 void sidekiq_rx_impl::set_rx_gain_index(int value) 
 {
     int status = 0;
+    uint32_t written = 0;
     uint8_t min_range = 0;
     uint8_t max_range = 0;
     
     d_logger->debug("in set_rx_gain_index");
+    std::lock_guard<std::recursive_mutex> guard(config_mutex);
 
     auto gain = static_cast<uint8_t>(value);
 
+    /* before start() the setting is only staged, apply_radio_config() writes it */
+    if (radio_configured == false)
+    {
+        this->gain_index = gain;
+        return;
+    }
+
     if (this->gain_mode == skiq_rx_gain_manual)
     {
-        status = skiq_read_rx_gain_index_range(card, hdl1, &min_range, &max_range);
-        if (status != 0) 
-        {
-            d_logger->error("Error: read_rx_gain_index failed, status {}, {}", 
-                    status, strerror(abs(status)) );
-            throw std::runtime_error("Failure: set read_rx_gain_index");
-            return;
-        }
-        d_logger->info("Info: gain range for current frequency is {} - {}", min_range, max_range);
+        read_gain_range(&min_range, &max_range);
 
         if (gain > max_range || gain < min_range)
         {
@@ -632,28 +1140,30 @@ void sidekiq_rx_impl::set_rx_gain_index(int value)
             return;
         }
 
-        status = skiq_write_rx_gain(card, hdl1, gain);
-        if (status != 0) 
+        for (uint32_t i = 0; i < num_ports; i++)
         {
-            d_logger->error("Error: write_rx_gain failed on hdl1, status {}, {}", 
-                    status, strerror(abs(status)) );
-            throw std::runtime_error("Failure: set read_rx_gain_index");
-            return;
-        }
+            if (ports[i].hw_gain == gain)
+            {
+                continue;
+            }
 
-        if (dual_port == true)
-        {
-            status = skiq_write_rx_gain(card, hdl2, gain);
+            ports[i].hw_gain = -1;
+            status = skiq_write_rx_gain(ports[i].card, ports[i].hdl, gain);
             if (status != 0) 
             {
-                d_logger->error("Error: write_rx_gain failed on hdl2, status {}, {}", 
-                        status, strerror(abs(status)) );
+                d_logger->error("Error: write_rx_gain failed on hdl {}, status {}, {}", 
+                        ports[i].hdl, status, strerror(abs(status)) );
                 throw std::runtime_error("Failure: set read_rx_gain_index");
                 return;
             }
+            ports[i].hw_gain = gain;
+            written++;
         }
 
-        d_logger->info("Info: gain index {}", gain); 
+        if (written > 0)
+        {
+            d_logger->info("Info: gain index {}", gain); 
+        }
 
         this->gain_index = gain;
     }
@@ -664,6 +1174,35 @@ void sidekiq_rx_impl::set_rx_gain_index(int value)
 }
 
 
+/*
+ * read_gain_range
+ *
+ * The gain index range depends on the LO frequency.  It is read on the first gain write 
+ * after the LO is tuned and kept until the next tune, so gain changes from a slider do not 
+ * read it back from the card every time.
+ */
+void sidekiq_rx_impl::read_gain_range(uint8_t *p_min, uint8_t *p_max)
+{
+    int status = 0;
+    std::lock_guard<std::recursive_mutex> guard(config_mutex);
+
+    if (gain_range_valid == false)
+    {
+        status = skiq_read_rx_gain_index_range(ports[0].card, ports[0].hdl, &gain_range_min, &gain_range_max);
+        if (status != 0) 
+        {
+            d_logger->error("Error: read_rx_gain_index failed, status {}, {}", 
+                    status, strerror(abs(status)) );
+            throw std::runtime_error("Failure: set read_rx_gain_index");
+        }
+        d_logger->debug("gain range for frequency {} is {} - {}", frequency, gain_range_min, gain_range_max);
+        gain_range_valid = true;
+    }
+
+    *p_min = gain_range_min;
+    *p_max = gain_range_max;
+}
+
 /* 
  * set the cal_mode
  * this may be called from the generated python code if the user changes the variable
@@ -675,6 +1214,7 @@ void sidekiq_rx_impl::set_rx_cal_mode(int value)
     int status = 0;
 
     d_logger->debug("in set_cal_mode");
+    std::lock_guard<std::recursive_mutex> guard(config_mutex);
 
     if (value == CAL_OFF)
     {
@@ -686,33 +1226,34 @@ void sidekiq_rx_impl::set_rx_cal_mode(int value)
         cal_enabled = true;
         auto cmode = static_cast<skiq_rx_cal_mode_t>(value);
 
+        /* before start() the setting is only staged, apply_radio_config() writes it */
+        if (radio_configured == false)
+        {
+            this->cal_mode = cmode;
+            return;
+        }
+
         /* set the calibration mode */
-        status = skiq_write_rx_cal_mode( card, hdl1, cmode );
-        if( status != 0 )
+        for (uint32_t i = 0; i < num_ports; i++)
         {
-            if( status != -ENOTSUP )
-            {
-                d_logger->error( "Error: failed to configure RX calibration mode with {}", status);
-                throw std::runtime_error("Failure: set rx_cal_mode");
-            }
-            else
+            if (ports[i].hw_cal_mode == cmode)
             {
-                d_logger->warn("Warning: calibration mode {} unsupported with product", cmode);
+                continue;
             }
-        }
 
-        if (dual_port == true)
-        {
-            status = skiq_write_rx_cal_mode( card, hdl2, cmode );
+            ports[i].hw_cal_mode = cmode;
+            status = skiq_write_rx_cal_mode( ports[i].card, ports[i].hdl, cmode );
             if( status != 0 )
             {
                 if( status != -ENOTSUP )
                 {
+                    ports[i].hw_cal_mode = -1;
                     d_logger->error( "Error: failed to configure RX calibration mode with {}", status);
                     throw std::runtime_error("Failure: set rx_cal_mode");
                 }
                 else
                 {
+                    /* not supported, asking again will not change that */
                     d_logger->warn("Warning: calibration mode {} unsupported with product", cmode);
                 }
             }
@@ -739,6 +1280,14 @@ void sidekiq_rx_impl::set_rx_cal_type(int value)
     uint32_t cal_mask = (uint32_t)(skiq_rx_cal_type_none);
 
     d_logger->debug("in set_cal_type");
+    std::lock_guard<std::recursive_mutex> guard(config_mutex);
+
+    /* before start() the setting is only staged, apply_radio_config() writes it */
+    this->cal_type_setting = value;
+    if (radio_configured == false)
+    {
+        return;
+    }
 
     /* The cal_mask is a bitmap of the types of calibration */    
     if (cal_enabled == true)
@@ -758,7 +1307,7 @@ void sidekiq_rx_impl::set_rx_cal_type(int value)
 
         /* read in what this card can handle */
         uint32_t read_cal_mask = 0;
-        if( (status = skiq_read_rx_cal_types_avail( card, hdl1, &read_cal_mask )) == 0 )
+        if( (status = skiq_read_rx_cal_types_avail( ports[0].card, ports[0].hdl, &read_cal_mask )) == 0 )
         {
             if( read_cal_mask != cal_mask )
             {
@@ -775,21 +1324,21 @@ void sidekiq_rx_impl::set_rx_cal_type(int value)
         }
 
         /* write the cal mask */
-        status = skiq_write_rx_cal_type_mask( card, hdl1, cal_mask );
-        if( status != 0 )
+        for (uint32_t i = 0; i < num_ports; i++)
         {
-            d_logger->error( "Error: failed to configure RX calibration type with status {}", status);
-            throw std::runtime_error("Failure: set rx_cal_type");
-        }
+            if (ports[i].hw_cal_mask == cal_mask)
+            {
+                continue;
+            }
 
-        if (dual_port == true)
-        {
-            status = skiq_write_rx_cal_type_mask( card, hdl2, cal_mask );
+            ports[i].hw_cal_mask = -1;
+            status = skiq_write_rx_cal_type_mask( ports[i].card, ports[i].hdl, cal_mask );
             if( status != 0 )
             {
                 d_logger->error( "Error: failed to configure RX calibration type with status {}", status);
                 throw std::runtime_error("Failure: set rx_cal_type");
             }
+            ports[i].hw_cal_mask = cal_mask;
         }
 
         d_logger->info("Info: rx cal_mask 0x{:02X}, written successfully", cal_mask);
@@ -809,22 +1358,16 @@ void sidekiq_rx_impl::run_rx_cal(int value)
     int status = 0;
 
     d_logger->debug("in run_rx_cal");
+    std::lock_guard<std::recursive_mutex> guard(config_mutex);
 
     /* only run calibration if calibration is enabled, in manual mode, 
      * and this call has the right parameter */
     if ((value == RUN_CAL) && (cal_enabled == true) && (cal_mode == skiq_rx_cal_mode_manual) )
     {    
         d_logger->debug("in run_rx_cal() ");
-        status = skiq_run_rx_cal( card, hdl1);
-        if( status != 0 )
+        for (uint32_t i = 0; i < num_ports; i++)
         {
-            d_logger->error( "Error: run_rx_cal failed with status %" PRIi32 "", status);
-            throw std::runtime_error("Failure: set rx_cal_type");
-        }
-
-        if (dual_port == true)
-        {
-            status = skiq_run_rx_cal( card, hdl1);
+            status = skiq_run_rx_cal( ports[i].card, ports[i].hdl);
             if( status != 0 )
             {
                 d_logger->error( "Error: run_rx_cal failed with status %" PRIi32 "", status);
@@ -837,76 +1380,679 @@ void sidekiq_rx_impl::run_rx_cal(int value)
 }
 
 
+/*
+ * capture_loop
+ *
+ * Runs on the capture thread when capture_blocks is set.  It drains skiq_receive() as fast 
+ * as the card produces blocks and copies them into the ring, work() only pulls from the ring.
+ */
+void sidekiq_rx_impl::capture_loop()
+{
+    skiq_rx_status_t status{};
+    uint32_t card_index{};
+    skiq_rx_hdl_t tmp_hdl{};
+    uint32_t data_length_bytes{};
+    skiq_rx_block_t *p_rx_block{};
+
+    while (capture_running.load(std::memory_order_relaxed) == true)
+    {
+        status = receive_from_card(&card_index, &tmp_hdl, &p_rx_block, &data_length_bytes);
+        if (status == skiq_rx_status_success)
+        {
+            /* if the ring is full the block is dropped, work() sees it as a timestamp overrun */
+            capture_ring->push(card_index, tmp_hdl, p_rx_block, data_length_bytes);
+        }
+        else if (status == skiq_rx_status_no_data)
+        {
+            /* the receive strategy already waited */
+        }
+        else if (status == skiq_rx_status_error_overrun)
+        {
+            /* if we get an overrun, it will be detected in the next timestamp overrun test */
+        }
+        else
+        {
+            /* hand the failure to work() so it is reported on the scheduler thread */
+            capture_status = status;
+            break;
+        }
+    }
+}
+
+void sidekiq_rx_impl::stop_capture_thread()
+{
+    capture_running = false;
+
+    if (capture_thread.joinable())
+    {
+        capture_thread.join();
+        d_logger->info("Info: RX capture thread stopped");
+    }
+}
+
+/*
+ * set_transfer_timeout
+ *
+ * RX_TRANSFER_NO_WAIT makes skiq_receive() return immediately when there is no data,
+ * anything else makes it block in the driver for up to timeout_us.
+ */
+void sidekiq_rx_impl::set_transfer_timeout(int32_t timeout_us)
+{
+    int status = 0;
+
+    for (uint32_t c = 0; c < num_cards; c++)
+    {
+        status = skiq_set_rx_transfer_timeout(cards[c], timeout_us);
+        if (status != 0)
+        {
+            d_logger->error( "Error: could not set RX transfer timeout to {}, status {}", timeout_us, status);
+            throw std::runtime_error("Failure: skiq_set_rx_transfer_timeout");
+        }
+    }
+}
+
+/*
+ * receive_from_card
+ *
+ * One skiq_receive() attempt, waiting according to the receive strategy when there is no data.
+ * It still returns skiq_rx_status_no_data in that case, the caller just tries again.
+ *
+ * With several cards each one is tried once, round robin so no card is starved, and the 
+ * strategy only waits when none of them had a block.
+ */
+skiq_rx_status_t sidekiq_rx_impl::receive_from_card(uint32_t *p_card_index, skiq_rx_hdl_t *p_hdl, 
+        skiq_rx_block_t **pp_block, uint32_t *p_length)
+{
+    skiq_rx_status_t status = skiq_rx_status_no_data;
+
+    for (uint32_t n = 0; (n < num_cards) && (status == skiq_rx_status_no_data); n++)
+    {
+        *p_card_index = next_card;
+        next_card = (next_card + 1) % num_cards;
+        status = skiq_receive(cards[*p_card_index], p_hdl, pp_block, p_length);
+    }
+
+    if (status == skiq_rx_status_no_data)
+    {
+        if (rx_strategy == RX_STRATEGY_POLL)
+        {
+            usleep(NON_BLOCKING_TIMEOUT);
+        }
+        else if (rx_strategy == RX_STRATEGY_ADAPTIVE && adaptive_blocking == false)
+        {
+            auto now = std::chrono::steady_clock::now();
+
+            if (adaptive_spinning == false)
+            {
+                adaptive_spinning = true;
+                adaptive_spin_start = now;
+            }
+            else if ((now - adaptive_spin_start) > std::chrono::microseconds(ADAPTIVE_SPIN_TIME))
+            {
+                /* the stream has gone quiet, stop burning the core and wait in the driver */
+                set_transfer_timeout(RX_TRANSFER_TIMEOUT);
+                adaptive_blocking = true;
+            }
+        }
+    }
+    else if (rx_strategy == RX_STRATEGY_ADAPTIVE)
+    {
+        /* data is flowing again, go back to spinning */
+        adaptive_spinning = false;
+        if (adaptive_blocking == true)
+        {
+            set_transfer_timeout(RX_TRANSFER_NO_WAIT);
+            adaptive_blocking = false;
+        }
+    }
+
+    return status;
+}
+
+/*
+ * report_receive_cpu
+ *
+ * Logs the CPU load of the thread calling skiq_receive() since the last report.
+ * That is the capture thread when it is enabled, otherwise the work() thread.
+ */
+void sidekiq_rx_impl::report_receive_cpu()
+{
+    clockid_t cpu_clock = CLOCK_THREAD_CPUTIME_ID;
+    struct timespec cpu_time{};
+
+    if (capture_thread.joinable())
+    {
+        if (pthread_getcpuclockid(capture_thread.native_handle(), &cpu_clock) != 0)
+        {
+            return;
+        }
+    }
+
+    if (clock_gettime(cpu_clock, &cpu_time) != 0)
+    {
+        return;
+    }
+
+    double cpu_seconds = cpu_time.tv_sec + (cpu_time.tv_nsec * 1e-9);
+    auto now = std::chrono::steady_clock::now();
+
+    if (cpu_report_valid == true)
+    {
+        double wall_seconds = std::chrono::duration<double>(now - last_cpu_report_time).count();
+        if (wall_seconds > 0)
+        {
+            d_logger->info("Info: RX receive thread CPU {:.1f}% ({} strategy)",
+                    100.0 * (cpu_seconds - last_cpu_seconds) / wall_seconds,
+                    rx_strategy_names[rx_strategy]);
+        }
+    }
+
+    cpu_report_valid = true;
+    last_cpu_seconds = cpu_seconds;
+    last_cpu_report_time = now;
+}
+
+/*
+ * receive_block
+ *
+ * Same contract as skiq_receive(), the returned block is valid until the next call.
+ * When the capture thread is enabled, the block comes out of the capture ring instead,
+ * and when the card is shared it comes out of the dispatch rings.
+ */
+skiq_rx_status_t sidekiq_rx_impl::receive_block(uint32_t *p_card_index, skiq_rx_hdl_t *p_hdl, 
+        skiq_rx_block_t **pp_block, uint32_t *p_length)
+{
+    if (dispatched == true)
+    {
+        return receive_dispatched(p_card_index, p_hdl, pp_block, p_length);
+    }
+
+    if (!capture_ring)
+    {
+        return receive_from_card(p_card_index, p_hdl, pp_block, p_length);
+    }
+
+    /* the slot handed out on the previous call is no longer in use */
+    if (capture_slot_held == true)
+    {
+        capture_ring->pop();
+        capture_slot_held = false;
+    }
+
+    if (capture_ring->front(p_card_index, p_hdl, pp_block, p_length) == true)
+    {
+        capture_slot_held = true;
+        return skiq_rx_status_success;
+    }
+
+    if (capture_status != 0)
+    {
+        return static_cast<skiq_rx_status_t>(capture_status.load());
+    }
+
+    return skiq_rx_status_no_data;
+}
+
+/*
+ * receive_dispatched
+ *
+ * Takes the next block out of the dispatch rings, trying the cards round robin like
+ * receive_from_card() does.  The slot is held until the next call.
+ */
+skiq_rx_status_t sidekiq_rx_impl::receive_dispatched(uint32_t *p_card_index, skiq_rx_hdl_t *p_hdl, 
+        skiq_rx_block_t **pp_block, uint32_t *p_length)
+{
+    int32_t status = 0;
+
+    if (dispatch_slot_held >= 0)
+    {
+        dispatch_rings[dispatch_slot_held]->pop();
+        dispatch_slot_held = -1;
+    }
+
+    for (uint32_t n = 0; n < num_cards; n++)
+    {
+        uint32_t c = next_card;
+
+        next_card = (next_card + 1) % num_cards;
+        if (dispatch_rings[c]->front(p_card_index, p_hdl, pp_block, p_length) == true)
+        {
+            dispatch_slot_held = static_cast<int32_t>(c);
+            return skiq_rx_status_success;
+        }
+    }
+
+    for (uint32_t c = 0; c < num_cards; c++)
+    {
+        status = rx_dispatcher::instance().status(cards[c]);
+        if (status != 0)
+        {
+            return static_cast<skiq_rx_status_t>(status);
+        }
+    }
+
+    return skiq_rx_status_no_data;
+}
+
+/*
+ * card_handles
+ *
+ * The handles this block streams on cards[card_index], returns how many there are.
+ */
+uint8_t sidekiq_rx_impl::card_handles(uint32_t card_index, skiq_rx_hdl_t *p_handles)
+{
+    uint8_t nrhandles = 0;
+
+    for (uint32_t i = 0; i < num_ports; i++)
+    {
+        if (ports[i].card == cards[card_index])
+        {
+            p_handles[nrhandles++] = ports[i].hdl;
+        }
+    }
+
+    return nrhandles;
+}
+
+/*
+ * apply_timed_commands
+ *
+ * Applies the commands whose rf_timestamp the card has reached.  The card timestamp is read
+ * again after each change, the samples from there on were taken with the new setting, so
+ * that is where the rx_freq or rx_gain tag goes on every port of the card.
+ */
+void sidekiq_rx_impl::apply_timed_commands()
+{
+    timed_command_queue::command cmd{};
+    skiq_rx_hdl_t handles[skiq_rx_hdl_end];
+    uint64_t card_timestamp{};
+    uint64_t now_timestamp{};
+    bool have_timestamp = false;
+    int status = 0;
+
+    /* nothing queued, which is almost every call, does not need the lock */
+    if (timed_commands->front(&cmd) == false)
+    {
+        return;
+    }
+
+    std::lock_guard<std::recursive_mutex> guard(config_mutex);
+    while (timed_commands->front(&cmd) == true)
+    {
+        if (cmd.timestamp != 0)
+        {
+            if (have_timestamp == false)
+            {
+                status = skiq_read_curr_rx_timestamp(cards[0], ports[0].hdl, &now_timestamp);
+                if (status != 0)
+                {
+                    d_logger->error( "Error: could not read the RX timestamp, status {}", status);
+                    throw std::runtime_error("Failure: skiq_read_curr_rx_timestamp");
+                }
+                have_timestamp = true;
+            }
+
+            if (cmd.timestamp > now_timestamp)
+            {
+                break;
+            }
+        }
+        timed_commands->pop();
+
+        if ((cmd.flags & timed_command_queue::SET_FREQUENCY) != 0)
+        {
+            set_rx_frequency(cmd.frequency);
+        }
+
+        if ((cmd.flags & timed_command_queue::SET_GAIN) != 0)
+        {
+            set_rx_gain_index(cmd.gain_index);
+        }
+
+        for (uint32_t c = 0; c < num_cards; c++)
+        {
+            gr::tag_t tag;
+
+            card_handles(c, handles);
+            status = skiq_read_curr_rx_timestamp(cards[c], handles[0], &card_timestamp);
+            if (status != 0)
+            {
+                d_logger->error( "Error: could not read the RX timestamp on card {}, status {}", cards[c], status);
+                throw std::runtime_error("Failure: skiq_read_curr_rx_timestamp");
+            }
+            if (c == 0)
+            {
+                now_timestamp = card_timestamp;
+            }
+
+            for (uint32_t i = 0; i < num_ports; i++)
+            {
+                if (ports[i].card != cards[c])
+                {
+                    continue;
+                }
+
+                tag.offset = card_timestamp;
+                if ((cmd.flags & timed_command_queue::SET_FREQUENCY) != 0)
+                {
+                    tag.key = RX_FREQ_KEY;
+                    tag.value = pmt::from_double(static_cast<double>(frequency));
+                    queue_setting_tag(i, tag);
+                }
+
+                if ((cmd.flags & timed_command_queue::SET_GAIN) != 0)
+                {
+                    tag.key = RX_GAIN_KEY;
+                    tag.value = pmt::from_long(gain_index);
+                    queue_setting_tag(i, tag);
+                }
+            }
+        }
+
+        /* card 0 was just read again after the change, the next command is checked against
+         * that reading instead of a new one */
+        have_timestamp = true;
+        d_logger->debug("timed command at rf_timestamp {} applied at {}", cmd.timestamp, card_timestamp);
+    }
+}
+
+/*
+ * queue_setting_tag
+ *
+ * Holds tag until place_setting_tags() reaches its rf_timestamp.  If the port is so far 
+ * behind that the ring is full, the tag is dropped.
+ */
+void sidekiq_rx_impl::queue_setting_tag(uint32_t portno, const gr::tag_t &tag)
+{
+    rx_port_state &port = ports[portno];
+
+    if (port.setting_tags.push(tag) == false)
+    {
+        d_logger->warn("Warning: {} setting tags already waiting on port {}, the tag at rf_timestamp {} is dropped",
+                port.setting_tags.capacity(), portno, tag.offset);
+    }
+}
+
+/*
+ * place_setting_tags
+ *
+ * samples are about to be written from the current block at output offset.  Every setting 
+ * tag whose rf_timestamp falls in them, or has already passed, is put on its sample.
+ */
+void sidekiq_rx_impl::place_setting_tags(uint32_t portno, uint64_t offset, uint32_t samples)
+{
+    rx_port_state &port = ports[portno];
+    uint64_t end_timestamp = port.curr_timestamp + samples;
+
+    /* the tags were queued in rf_timestamp order */
+    const gr::tag_t *p_tag = port.setting_tags.front();
+    while ((p_tag != NULL) && (p_tag->offset < end_timestamp))
+    {
+        uint64_t skip = (p_tag->offset > port.curr_timestamp) ? (p_tag->offset - port.curr_timestamp) : 0;
+
+        add_item_tag(portno, offset + skip, p_tag->key, p_tag->value);
+        port.setting_tags.pop();
+        p_tag = port.setting_tags.front();
+    }
+}
+
+/*
+ * align_block
+ *
+ * With several cards the ports do not all start on the same rf_timestamp.  Blocks are dropped
+ * until every port has received one, the common start is the end of the latest of those blocks.
+ * Each port then drops the samples ahead of it so the outputs line up sample for sample.
+ *
+ * Returns false if the whole block is dropped, otherwise p_skip_samples is set to the number
+ * of samples at the start of the block that come before the common start.
+ */
+bool sidekiq_rx_impl::align_block(uint64_t timestamp, uint32_t *p_skip_samples)
+{
+    uint64_t block_end = timestamp + rx_block_size;
+
+    *p_skip_samples = 0;
+
+    if (align_pending == true)
+    {
+        align_timestamp = std::max(align_timestamp, block_end);
+
+        for (uint32_t i = 0; i < num_ports; i++)
+        {
+            if (ports[i].first_block == true)
+            {
+                return false;
+            }
+        }
+
+        align_pending = false;
+        d_logger->info("Info: {} ports aligned at rf_timestamp {}", num_ports, align_timestamp);
+
+        return false;
+    }
+
+    if (block_end <= align_timestamp)
+    {
+        return false;
+    }
+
+    if (timestamp < align_timestamp)
+    {
+        *p_skip_samples = static_cast<uint32_t>(align_timestamp - timestamp);
+    }
+
+    return true;
+}
+
+/*
+ * load_block
+ *
+ * Makes p_rx_block the current block of portno, after the overrun check and, with several
+ * cards, the alignment.  Returns false if the whole block was dropped by the alignment.
+ *
+ * in_receive_memory is true when the block is only valid until the next receive_block().
+ */
+bool sidekiq_rx_impl::load_block(uint32_t portno, const skiq_rx_block_t *p_rx_block, bool in_receive_memory)
+{
+    rx_port_state &port = ports[portno];
+    uint32_t skip_samples{};
+
+    /* check timestamp for overrun */
+    if (port.first_block == false)
+    {
+        uint64_t actual_tx = p_rx_block->rf_timestamp;
+        uint64_t expected_ts = port.last_timestamp + rx_block_size;
+
+        if (expected_ts != actual_tx)
+        {
+            overrun_counter++;
+
+            /* work() tags the first sample after the gap with the number of samples lost */
+            uint64_t lost = (actual_tx > expected_ts) ? (actual_tx - expected_ts) : 0;
+            port.overrun_lost_samples = lost;
+            port.overrun_tag_pending = true;
+
+            if (zero_fill == true)
+            {
+                if (lost <= static_cast<uint64_t>(sample_rate * MAX_ZERO_FILL_SECONDS))
+                {
+                    port.fill_samples_left = lost;
+                }
+                else
+                {
+                    d_logger->warn("Warning: gap of {} samples on port {} is too large to zero fill",
+                            lost, portno);
+                }
+            }
+        }
+    }
+
+
+    port.last_timestamp = p_rx_block->rf_timestamp;
+    port.first_block = false;
+
+    /* with several cards, drop whatever comes before the common start of all the ports */
+    if (num_cards > 1)
+    {
+        bool keep = align_block(p_rx_block->rf_timestamp, &skip_samples);
+
+        /* a gap before the common start is never output */
+        if (keep == false || skip_samples > 0)
+        {
+            port.overrun_tag_pending = false;
+            port.fill_samples_left = 0;
+        }
+
+        if (keep == false)
+        {
+            return false;
+        }
+    }
+
+    /* if enabled for stream tags, set the tag value, the key was set in the constructor.  A pmt
+     * can not be changed once made, so this is one allocation per block while tags are on */
+    if (timestamp_tags == true)
+    {
+        port.rf_block_tag.value = pmt::from_uint64(p_rx_block->rf_timestamp + skip_samples);
+        port.rf_tag_pending = true;
+    }
+
+
+    /* update the data with the new block */
+    if (packed_mode == true)
+    {
+        unpack_12bit_iq(port.unpack_buffer.data(), 
+                reinterpret_cast<const uint32_t *>(p_rx_block->data), rx_block_size);
+        port.curr_block_ptr = port.unpack_buffer.data();
+        port.block_in_receive_memory = false;
+    }
+    else
+    {
+        port.curr_block_ptr = (int16_t *)p_rx_block->data;
+        port.block_in_receive_memory = in_receive_memory;
+    }
+    port.curr_block_ptr += skip_samples * IQ_SHORT_COUNT;
+    port.curr_block_samples_left = rx_block_size - skip_samples;
+    port.curr_timestamp = p_rx_block->rf_timestamp + skip_samples;
+
+    return true;
+}
+
+/*
+ * keep_block_remainders
+ *
+ * The next receive_block() may reuse the memory of the block it returned last.  A port that
+ * filled its output part way through that block keeps the rest in its carry_buffer.
+ */
+void sidekiq_rx_impl::keep_block_remainders()
+{
+    for (uint32_t i = 0; i < num_ports; i++)
+    {
+        rx_port_state &port = ports[i];
+
+        if (port.block_in_receive_memory == true && port.curr_block_samples_left > 0)
+        {
+            memcpy(port.carry_buffer.data(), port.curr_block_ptr, 
+                    port.curr_block_samples_left * IQ_SHORT_COUNT * sizeof(int16_t));
+            port.curr_block_ptr = port.carry_buffer.data();
+        }
+        port.block_in_receive_memory = false;
+    }
+}
+
 /*
  * get_new_block
  *
  * This call will wait until we get a new block of data.
  *
+ * The block may be for another port than portno, that port is returned.  With several ports,
+ * a block for a port that still has samples, or whose output is already full, goes to the
+ * backlog of that port, and portno first takes the blocks in its own backlog.
  */
-uint32_t sidekiq_rx_impl::get_new_block(uint32_t portno)
+uint32_t sidekiq_rx_impl::get_new_block(uint32_t portno, const int32_t *samples_written, int32_t noutput_items)
 {
     int status = 0;
+    uint32_t card_index{};
     skiq_rx_hdl_t tmp_hdl{};
     uint32_t data_length_bytes{};
     skiq_rx_block_t *p_rx_block{};
     uint32_t new_portno = portno;
     bool done = false;
 
+    /* blocks held back for this port come first, in the order they arrived */
+    if (ports[portno].backlog)
+    {
+        rx_port_state &port = ports[portno];
+
+        if (port.backlog_slot_held == true)
+        {
+            port.backlog->pop();
+            port.backlog_slot_held = false;
+        }
+
+        while (port.backlog->front(&card_index, &tmp_hdl, &p_rx_block, &data_length_bytes) == true)
+        {
+            /* the slot is popped once the port needs its next block */
+            port.backlog_slot_held = true;
+            if (load_block(portno, p_rx_block, false) == true)
+            {
+                return portno;
+            }
+
+            port.backlog->pop();
+            port.backlog_slot_held = false;
+        }
+    }
 
     while (done == false)
     {
-        status = skiq_receive(card, &tmp_hdl, &p_rx_block, &data_length_bytes);
+        /* the receive below may reuse the memory the other ports are still reading from */
+        if (num_ports > 1)
+        {
+            keep_block_remainders();
+        }
+
+        status = receive_block(&card_index, &tmp_hdl, &p_rx_block, &data_length_bytes);
         if (status  == skiq_rx_status_success) 
         {
             /* determine which port the received block is from */
-            if (tmp_hdl == hdl1)
-            {
-                new_portno = 0;
-            }
-            else if (tmp_hdl == hdl2)
+            if (tmp_hdl >= skiq_rx_hdl_end || hdl_to_port[card_index][tmp_hdl] < 0)
             {
-                new_portno = 1;
-            }
-            else
-            {
-              d_logger->error( "Error : invalid hdl received {}", tmp_hdl);
+              d_logger->error( "Error : invalid hdl received {} on card {}", tmp_hdl, cards[card_index]);
               throw std::runtime_error("Failure:  invalid handle");
             }
+            new_portno = hdl_to_port[card_index][tmp_hdl];
 
-            /* check timestamp for overrun */
-            if (first_block[new_portno] == false)
+            /* a port that is not ready for the block keeps a copy, if its backlog is full the 
+             * block is dropped and the overrun check of the next block tags the gap */
+            if (new_portno != portno)
             {
-                uint64_t actual_tx = p_rx_block->rf_timestamp;
-                uint64_t expected_ts = last_timestamp[new_portno] + DATA_MAX_BUFFER_SIZE;
+                rx_port_state &port = ports[new_portno];
+                bool exhausted = (port.curr_block_samples_left == 0) && (port.fill_samples_left == 0);
 
-                if (expected_ts != actual_tx)
+                if (exhausted == true && port.backlog_slot_held == true)
                 {
-                    overrun_counter++;
+                    port.backlog->pop();
+                    port.backlog_slot_held = false;
                 }
-            }
-
 
-            /* if enabled for stream tags, set the tag value */
-            if (timestamp_tags == true)
-            {
-                curr_rf_block_tag.key = pmt::intern("rf_timestamp");
-                curr_rf_block_tag.value = pmt::from_uint64(p_rx_block->rf_timestamp);
+                if (exhausted == false || samples_written[new_portno] >= noutput_items || 
+                        port.backlog->empty() == false)
+                {
+                    port.backlog->push(card_index, tmp_hdl, p_rx_block, data_length_bytes);
+                    continue;
+                }
             }
 
-            last_timestamp[new_portno] = p_rx_block->rf_timestamp;
-            first_block[new_portno] = false;
-
-
-            /* update the data with the new block */
-            curr_block_ptr[new_portno] = (int16_t *)p_rx_block->data;
-            curr_block_samples_left[new_portno] = DATA_MAX_BUFFER_SIZE;
-            done = true;
+            done = load_block(new_portno, p_rx_block, true);
         }
         else if (status == skiq_rx_status_no_data)
         {
-            /* we are non-blocking so we will get this status */
+            /* the card wait is done by the receive strategy, only the rings need a nap */
             done = false;
-            usleep(NON_BLOCKING_TIMEOUT);
+            if ((capture_ring || dispatched == true) && rx_strategy != RX_STRATEGY_SPIN)
+            {
+                usleep(NON_BLOCKING_TIMEOUT);
+            }
         }
         else if (status == skiq_rx_status_error_overrun)
         {
@@ -929,62 +2075,36 @@ uint32_t sidekiq_rx_impl::get_new_block(uint32_t portno)
 /*
  * determine_if_done
  *
- * With multiple ports, we need to get all the data from both ports then we are done.
+ * With multiple ports, we need to get all the data from every port then we are done.
  *
- * With single port, this will just determine if we have enough data for the single port
+ * Stay on the current port while it still needs samples, otherwise move to the first port
+ * that does.  With a single port this just determines if we have enough data for it.
  *
+ * A port is done once its output is full.  Whatever is left of its block, or of a gap 
+ * being zero filled, carries over to the next work() call.
  */
 bool sidekiq_rx_impl::determine_if_done(int32_t *samples_written, int32_t noutput_items, uint32_t *portno)
 {
-    bool looping = true;
-
-
-    /* handle single port different than dual port */
-    if (dual_port)
+    /* the current port is not done so just leave the port as it is */
+    if (samples_written[*portno] < noutput_items)
     {
-        /* neither port is done so just leave the port as it is */
-        if (((samples_written[0] + DATA_MAX_BUFFER_SIZE) <= noutput_items) && 
-                ((samples_written[1] + DATA_MAX_BUFFER_SIZE)  <= noutput_items))
-        {
-            looping = true;
-        }
-        /* port 0 is done, but port 1 is not, force port to 1 */
-        else if (((samples_written[1] + DATA_MAX_BUFFER_SIZE) <= noutput_items) && 
-                (samples_written[0] + DATA_MAX_BUFFER_SIZE) > noutput_items)
-        {
-            *portno = 1;
-            looping = true;
-        }
-        /* port 1 is done, but port 0 is not, force port to 0 */
-        else if (((samples_written[0] + DATA_MAX_BUFFER_SIZE) <= noutput_items) && 
-                (samples_written[1] + DATA_MAX_BUFFER_SIZE) > noutput_items)
-        {
-            *portno = 0;
-            looping = true;
-        } 
-        /* both ports are done, reset portno to 0 and leave loop */
-        else
-        {
-            *portno = 0;
-            looping = false;
-        }
+        return true;
     }
-    else
+
+    /* the current port is done, force the port to one that is not */
+    for (uint32_t i = 0; i < num_ports; i++)
     {
-        /* single port, always port number is 0 */
-        if ((samples_written[0] + DATA_MAX_BUFFER_SIZE) <= noutput_items )
-        {
-            *portno = 0;
-            looping = true;
-        }
-        else
+        if (samples_written[i] < noutput_items)
         {
-            *portno = 0;
-            looping = false;
+            *portno = i;
+            return true;
         }
     }
 
-    return looping;
+    /* all the ports are done, reset portno to 0 and leave loop */
+    *portno = 0;
+
+    return false;
 }
 
 /*
@@ -996,33 +2116,27 @@ int sidekiq_rx_impl::work(int noutput_items,
                           gr_vector_const_void_star &input_items,
                           gr_vector_void_star &output_items) 
 {
-    int32_t samples_written[MAX_PORT]{};
-    int32_t delta_samples[MAX_PORT] = {noutput_items, noutput_items};
-    uint32_t samples_to_write[MAX_PORT]{};
+    int32_t samples_written[MAX_OUTPUTS]{};
+    int32_t delta_samples[MAX_OUTPUTS]{};
+    uint32_t samples_to_write[MAX_OUTPUTS]{};
     uint32_t portno{};
     bool looping = true; 
     Clock::time_point this_time;
 
     this_time = Clock::now();
-    gr_complex *out[MAX_PORT] = {NULL, NULL};
-    gr_complex *curr_out_ptr[MAX_PORT] = {NULL, NULL} ;
-
-    /* initialize the one-port output variables */    
-    out[0] = static_cast<gr_complex *>(output_items[0]);
-    curr_out_ptr[0] = out[0];
+    /* byte pointers since the item size depends on the output format */
+    uint8_t *out[MAX_OUTPUTS]{};
+    uint8_t *curr_out_ptr[MAX_OUTPUTS]{};
 
-    /* if dual port, initialize the other */
-    if (dual_port)
+    /* initialize the output variables of each port */    
+    for (uint32_t i = 0; i < num_ports; i++)
     { 
-        out[1] = static_cast<gr_complex *>(output_items[1]);
-        curr_out_ptr[1] = out[1];
+        out[i] = static_cast<uint8_t *>(output_items[i]);
+        curr_out_ptr[i] = out[i];
     }
 
-    first_block[0]  = true;
-    first_block[1]  = true;
-
     /* We told gnuradio to not call us with a buffer size smaller than our block, so error out. */
-    if (noutput_items < DATA_MAX_BUFFER_SIZE)
+    if (noutput_items < rx_block_size)
     {
         d_logger->error( "Error : invalid noutput_items {}", noutput_items);
         throw std::runtime_error("Failure: invalid noutput items");
@@ -1038,6 +2152,32 @@ int sidekiq_rx_impl::work(int noutput_items,
             d_logger->info("Overruns detected: {}", overrun_counter);
         }
 
+        uint64_t capture_dropped = capture_ring ? capture_ring->dropped() : 0;
+        for (uint32_t c = 0; (c < num_cards) && (dispatched == true); c++)
+        {
+            capture_dropped += dispatch_rings[c]->dropped();
+        }
+
+        if (capture_dropped != last_capture_dropped)
+        {
+            last_capture_dropped = capture_dropped;
+            d_logger->info("Capture ring full, blocks dropped: {}", last_capture_dropped);
+        }
+
+        uint64_t backlog_dropped = 0;
+        for (uint32_t i = 0; (i < num_ports) && ports[i].backlog; i++)
+        {
+            backlog_dropped += ports[i].backlog->dropped();
+        }
+
+        if (backlog_dropped != last_backlog_dropped)
+        {
+            last_backlog_dropped = backlog_dropped;
+            d_logger->info("Port backlog full, blocks dropped: {}", last_backlog_dropped);
+        }
+
+        report_receive_cpu();
+
 #ifdef DEBUG
         milliseconds ms = std::chrono::duration_cast<milliseconds>(this_time - last_time);
         last_time = this_time;
@@ -1052,20 +2192,63 @@ int sidekiq_rx_impl::work(int noutput_items,
         last_status_update_sample = nitems_written(0);
     }
 
+    /* retune between two work() calls so every sample is either before or after the change */
+    apply_timed_commands();
+
     /* loop until we have filled up these "out" packet(s) */
     while (looping == true)
     {
-        /* if we don't have a block get one, if the block is from another port, it will change the portno */
-        portno = get_new_block(portno);
+        /* if we have used up the block, and any gap fill ahead of it, get a new one.
+         * If the block is from another port, it will change the portno */
+        if ((ports[portno].curr_block_samples_left == 0) && (ports[portno].fill_samples_left == 0))
+        {
+            portno = get_new_block(portno, samples_written, noutput_items);
+        }
+
+        /* tag the first sample after an overrun gap, in zero fill mode that is the first zero */
+        if ((ports[portno].overrun_tag_pending == true) && (samples_written[portno] < noutput_items))
+        {
+            add_item_tag(portno, nitems_written(portno) + samples_written[portno],
+                    RX_OVERRUN_KEY, pmt::from_uint64(ports[portno].overrun_lost_samples));
+            ports[portno].overrun_tag_pending = false;
+        }
+
+        /* zero fill the gap ahead of the block so the stream stays on the rf_timestamp */
+        if ((ports[portno].fill_samples_left > 0) && (samples_written[portno] < noutput_items))
+        {
+            samples_to_write[portno] = std::min(ports[portno].fill_samples_left, 
+                    static_cast<uint64_t>(noutput_items - samples_written[portno]));
+
+            memset(curr_out_ptr[portno], 0, samples_to_write[portno] * output_item_size);
+
+            samples_written[portno] += samples_to_write[portno];
+            curr_out_ptr[portno] += samples_to_write[portno] * output_item_size;
+            ports[portno].fill_samples_left -= samples_to_write[portno];
+        }
 
         /* fill the output packet for this portno up with the contents of the block */
-        if ((curr_block_samples_left[portno] > 0) && (samples_written[portno] < noutput_items))
+        if ((ports[portno].fill_samples_left == 0) && (ports[portno].curr_block_samples_left > 0) && 
+                (samples_written[portno] < noutput_items))
         {
+            /* the rf_timestamp tag goes on the first sample of the block */
+            if (ports[portno].rf_tag_pending == true)
+            {
+                add_item_tag(portno, nitems_written(portno) + samples_written[portno], 
+                                ports[portno].rf_block_tag.key, ports[portno].rf_block_tag.value);
+                ports[portno].rf_tag_pending = false;
+
+                if (debug_ctr < 10)
+                {
+                    d_logger->debug("add item: ctr {}, portno {}, samples_written {}, noutput_items {}, buffer_size {}", 
+                            debug_ctr, portno, samples_written[portno], noutput_items, rx_block_size);
+                }
+            }
+
             /* figure out how many samples we have left to write */
             delta_samples[portno] = noutput_items - samples_written[portno];
 
             /* determine how many samples we can write */
-            if (delta_samples[portno] <= curr_block_samples_left[portno])
+            if (delta_samples[portno] <= ports[portno].curr_block_samples_left)
             {
                 /* the amount we have if the block is more than we need */
                 samples_to_write[portno] = delta_samples[portno];
@@ -1073,14 +2256,20 @@ int sidekiq_rx_impl::work(int noutput_items,
             } 
             else {
                /* there are fewer items left in the block than we need to write */
-                samples_to_write[portno] = curr_block_samples_left[portno];
+                samples_to_write[portno] = ports[portno].curr_block_samples_left;
+            }
+
+            if (ports[portno].setting_tags.empty() == false)
+            {
+                place_setting_tags(portno, nitems_written(portno) + samples_written[portno], 
+                        samples_to_write[portno]);
             }
 //#define DEBUG
 #ifdef DEBUG
             if (debug_ctr < 2)
             {
                 printf("portno %d, overrun ctr %lu, samples_left %d, samples_written %d, samples_to_write %u, noutput_items %d\n",
-                        portno, overrun_counter, curr_block_samples_left[portno], samples_written[portno], 
+                        portno, overrun_counter, ports[portno].curr_block_samples_left, samples_written[portno], 
                         samples_to_write[portno], noutput_items);
 
 #ifdef POO
@@ -1089,8 +2278,8 @@ int sidekiq_rx_impl::work(int noutput_items,
                     printf("0x%08X ", (1143 * 4));
                     for (int i=125; i < 141; i++)
                     {
-                        printf("0x%04X ", curr_block_ptr[portno][i * IQ_SHORT_COUNT + 1]);
-                        printf("0x%04X ", curr_block_ptr[portno][i * IQ_SHORT_COUNT]);
+                        printf("0x%04X ", ports[portno].curr_block_ptr[i * IQ_SHORT_COUNT + 1]);
+                        printf("0x%04X ", ports[portno].curr_block_ptr[i * IQ_SHORT_COUNT]);
                         if (i%4 == 0)
                         {
                             printf("\n");
@@ -1103,56 +2292,47 @@ int sidekiq_rx_impl::work(int noutput_items,
             }
 #endif
 
-            /* convert and write the samples */
-            volk_16i_s32f_convert_32f_u(
-                  (float *) curr_out_ptr[portno],
-                  (const int16_t *) curr_block_ptr[portno],
-                  adc_scaling,
-                  (samples_to_write[portno] * IQ_SHORT_COUNT ));
-
-
+            if (output_sc16 == true)
+            {
+                /* the block is already I/Q shorts, just copy it */
+                memcpy(curr_out_ptr[portno], ports[portno].curr_block_ptr, 
+                        samples_to_write[portno] * IQ_SHORT_COUNT * sizeof(int16_t));
+            }
+            else
+            {
+                /* convert and write the samples */
+                volk_16i_s32f_convert_32f_u(
+                      (float *) curr_out_ptr[portno],
+                      (const int16_t *) ports[portno].curr_block_ptr,
+                      adc_scaling,
+                      (samples_to_write[portno] * IQ_SHORT_COUNT ));
+            }
 
             /* increment all the pointers and counters */
             samples_written[portno] += samples_to_write[portno];
-            curr_out_ptr[portno] += samples_to_write[portno];
-            curr_block_ptr[portno] += (samples_to_write[portno] * IQ_SHORT_COUNT);
-            curr_block_samples_left[portno] -= samples_to_write[portno];
-
-            if (timestamp_tags == true)
-            {
-                add_item_tag(portno, last_tag_index[portno] + samples_written[portno], 
-                                curr_rf_block_tag.key, curr_rf_block_tag.value);
-
-                if (debug_ctr < 10)
-                {
-                    d_logger->debug("add item: ctr {}, portno {}, samples_written {}, noutput_items {}, buffer_size {}", 
-                            debug_ctr, portno, samples_written[portno], noutput_items, DATA_MAX_BUFFER_SIZE);
-                    d_logger->debug("key {}, value {}, abs_tag_index {}",
-                            last_tag_index[portno], curr_rf_block_tag.key, curr_rf_block_tag.value);
-                }
-            }
+            curr_out_ptr[portno] += samples_to_write[portno] * output_item_size;
+            ports[portno].curr_block_ptr += (samples_to_write[portno] * IQ_SHORT_COUNT);
+            ports[portno].curr_block_samples_left -= samples_to_write[portno];
+            ports[portno].curr_timestamp += samples_to_write[portno];
         }
 
-        /* update the absolute index into the stream */
-        last_tag_index[portno] = last_tag_index[portno] + samples_written[portno];
-
         /* determine if we are done with this work() call */
         looping = determine_if_done(samples_written, noutput_items, &portno);
 
     }
 
 
-    if (curr_block_samples_left[portno] == 0)
+    if (ports[portno].curr_block_samples_left == 0)
     {
-        curr_block_ptr[portno] = NULL;
+        ports[portno].curr_block_ptr = NULL;
     }
     
 #ifdef DEBUG
     if (debug_ctr < 30)
     {
         milliseconds ms = std::chrono::duration_cast<milliseconds>(this_time - last_time);
-        d_logger->debug("dual_port {}, items written {}, noutput_items {}, samples_written {}", 
-                dual_port, nitems_written(0), noutput_items, samples_written[portno]);
+        d_logger->debug("num_ports {}, items written {}, noutput_items {}, samples_written {}", 
+                num_ports, nitems_written(0), noutput_items, samples_written[portno]);
         std::cout << ms.count() << "ms\n";
         last_time = this_time;
     }
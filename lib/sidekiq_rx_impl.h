@@ -11,9 +11,22 @@
 #include <pmt/pmt.h>
 #include <gnuradio/sidekiq/sidekiq_rx.h>
 #include <sidekiq_api.h>
+#include <atomic>
 #include <chrono>
-
-#define MAX_PORT                2        // max ports allowed
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "rx_block_ring.h"
+#include "spsc_ring.h"
+#include "card_manager.h"
+#include "rx_dispatcher.h"
+#include "timed_command_queue.h"
+
+#define MAX_PORT                4        // max ports allowed, A1/A2/B1/B2 on an X4 or NV100
+#define MAX_CARDS               8        // max cards aggregated by one block
+#define MAX_OUTPUTS             (MAX_PORT * MAX_CARDS)
+#define NO_HANDLE               100      // port handle value for an unused port
 #define IQ_SHORT_COUNT          2        // number of shorts in a sample
 
 /* calibration modes */
@@ -30,6 +43,37 @@
 #define PKT_TIMEOUT             1000000 // 1ms
 
 #define NON_BLOCKING_TIMEOUT    10 // us
+
+#define CAPTURE_DISABLED        0        // capture_blocks value to receive inline in work()
+#define TIMED_COMMAND_DEPTH     64       // lo_freq and gain commands waiting for work()
+#define SETTING_TAG_DEPTH       (2 * TIMED_COMMAND_DEPTH)  // rx_freq and rx_gain tags waiting per port
+#define DISPATCH_RING_BLOCKS    64       // ring size per card when the card is shared and capture_blocks is 0
+#define PORT_BACKLOG_BLOCKS     16       // blocks held per port while that port can not take them
+
+/* output sample formats */
+#define OUTPUT_FORMAT_FC32      0        // gr_complex scaled to +/- 1.0
+#define OUTPUT_FORMAT_SC16      1        // raw I/Q shorts as delivered by the ADC
+
+/* what happens to the output stream when an overrun drops samples */
+#define OVERRUN_MODE_TAG        0        // tag the first sample after the gap
+#define OVERRUN_MODE_ZERO_FILL  1        // tag and zero fill the gap, keeps nitems_written on rf_timestamp
+
+#define MAX_ZERO_FILL_SECONDS   1.0      // larger gaps are tagged but not filled
+
+/* RX stream modes, these trade DMA block size for latency */
+#define STREAM_MODE_HIGH_TPUT   0        // largest blocks
+#define STREAM_MODE_LOW_LATENCY 1        // smallest blocks
+#define STREAM_MODE_BALANCED    2        // in between
+
+/* receive strategies, how the receiving thread waits for the next block */
+#define RX_STRATEGY_POLL        0        // non-blocking receive, usleep between polls
+#define RX_STRATEGY_BLOCKING    1        // block in the driver up to RX_TRANSFER_TIMEOUT
+#define RX_STRATEGY_ADAPTIVE    2        // spin for up to ADAPTIVE_SPIN_TIME, then block
+#define RX_STRATEGY_SPIN        3        // non-blocking receive in a tight loop
+#define RX_STRATEGY_END         4
+
+#define RX_TRANSFER_TIMEOUT     100000   // us, bounds how long a blocking receive holds off stop()
+#define ADAPTIVE_SPIN_TIME      50       // us
 using pmt::pmt_t;
 
 namespace gr {
@@ -38,7 +82,9 @@ namespace sidekiq {
     static const double STATUS_UPDATE_RATE_SECONDS{2.0};
 
     const bool SIDEKIQ_IQ_PACK_MODE_UNPACKED{false}; 
+    const bool SIDEKIQ_IQ_PACK_MODE_PACKED{true}; 
 
+    /* samples in the largest (high throughput) DMA block, the selected stream mode may use less */
     const int DATA_MAX_BUFFER_SIZE{SKIQ_MAX_RX_BLOCK_SIZE_IN_WORDS - SKIQ_RX_HEADER_SIZE_IN_WORDS};
 
     const pmt_t CONTROL_MESSAGE_PORT{pmt::string_to_symbol("command")};
@@ -51,6 +97,18 @@ namespace sidekiq {
 
     static const pmt_t GAIN_KEY{pmt::string_to_symbol("gain")};
 
+    /* rf_timestamp to apply the lo_freq and gain of the same message at */
+    static const pmt_t TIME_KEY{pmt::string_to_symbol("time")};
+
+    /* stream tag keys, interned once so work() never touches the symbol table */
+    static const pmt_t RF_TIMESTAMP_KEY{pmt::string_to_symbol("rf_timestamp")};
+
+    static const pmt_t RX_OVERRUN_KEY{pmt::string_to_symbol("rx_overrun")};
+
+    static const pmt_t RX_FREQ_KEY{pmt::string_to_symbol("rx_freq")};
+
+    static const pmt_t RX_GAIN_KEY{pmt::string_to_symbol("rx_gain")};
+
 class sidekiq_rx_impl : public sidekiq_rx {
 public:
   sidekiq_rx_impl(
@@ -66,7 +124,16 @@ public:
           int trigger_src,
           int pps_source,
           int cal_mode,
-          int cal_type
+          int cal_type,
+          int capture_blocks,
+          int output_format,
+          int rx_strategy,
+          int stream_mode,
+          int packed_mode,
+          int overrun_mode,
+          int port3_handle,
+          int port4_handle,
+          const std::vector<int> &extra_cards
           );
   ~sidekiq_rx_impl();
 
@@ -98,46 +165,159 @@ public:
 
 private:
     /* private methods */
-    uint32_t get_new_block(uint32_t portno);
+    void release_cards();
+    uint32_t get_new_block(uint32_t portno, const int32_t *samples_written, int32_t noutput_items);
+    bool load_block(uint32_t portno, const skiq_rx_block_t *p_rx_block, bool in_receive_memory);
+    void keep_block_remainders();
+    bool align_block(uint64_t timestamp, uint32_t *p_skip_samples);
+    skiq_rx_status_t receive_block(uint32_t *p_card_index, skiq_rx_hdl_t *p_hdl, 
+            skiq_rx_block_t **pp_block, uint32_t *p_length);
+    skiq_rx_status_t receive_from_card(uint32_t *p_card_index, skiq_rx_hdl_t *p_hdl, 
+            skiq_rx_block_t **pp_block, uint32_t *p_length);
+    skiq_rx_status_t receive_dispatched(uint32_t *p_card_index, skiq_rx_hdl_t *p_hdl, 
+            skiq_rx_block_t **pp_block, uint32_t *p_length);
+    uint8_t card_handles(uint32_t card_index, skiq_rx_hdl_t *p_handles);
+    void apply_radio_config();
+    void write_rate_and_bandwidth(uint32_t rate, uint32_t bw);
+    void read_gain_range(uint8_t *p_min, uint8_t *p_max);
+    void queue_tuning_command(pmt_t msg);
+    void apply_timed_commands();
+    void queue_setting_tag(uint32_t portno, const gr::tag_t &tag);
+    void place_setting_tags(uint32_t portno, uint64_t offset, uint32_t samples);
+    void set_transfer_timeout(int32_t timeout_us);
+    void report_receive_cpu();
+    void capture_loop();
+    void stop_capture_thread();
     bool determine_if_done(int32_t *samples_written, int32_t noutput_items, uint32_t *portno);
     double get_double_from_pmt_dict(pmt_t dict, pmt_t key, pmt_t not_found );
+    uint64_t get_uint64_from_pmt_dict(pmt_t dict, pmt_t key);
+    static size_t output_item_size_for(int output_format);
 
     /* passed in parameters */
     uint8_t card{};
-    skiq_rx_hdl_t hdl1{};
-    skiq_rx_hdl_t hdl2{};
+    uint8_t cards[MAX_CARDS]{};      /* cards[0] is card, followed by the extra cards */
+    uint32_t num_cards{};
     uint32_t sample_rate{};
     uint32_t bandwidth{};
     uint64_t frequency{};
     skiq_rx_gain_t gain_mode{};
     uint8_t gain_index{};
     bool timestamp_tags{};
+    bool output_sc16{};
+    bool packed_mode{};
+    size_t output_item_size{};
     skiq_rx_cal_mode_t cal_mode{};
     skiq_rx_cal_type_t cal_type{};
+    int cal_type_setting{};          /* CAL_TYPE_* value given to set_rx_cal_type() */
+
+    /* lo_freq and gain changes from the control port, applied by work() */
+    std::unique_ptr<timed_command_queue> timed_commands;
+
+    /* gain index range at the current LO frequency, read on the first gain write after a tune */
+    bool gain_range_valid{};
+    uint8_t gain_range_min{};
+    uint8_t gain_range_max{};
+
+    /* GRC callbacks, the message handler and work() all change the settings, the hw_* values
+     * of the ports and the gain range, each of them holds config_mutex while it does.  It is 
+     * recursive because the setters call each other */
+    std::recursive_mutex config_mutex;
 
     skiq_trigger_src_t trigger_src = skiq_trigger_src_immediate;
     skiq_1pps_source_t pps_source{}; 
+    skiq_rx_stream_mode_t stream_mode{};
 
     /* flags */    
     bool libsidekiq_init{};
-    bool rx_streaming{};
+    uint32_t num_dual_cards{};       /* cards[0] up to here hold a dual channel request */
+    std::atomic<bool> rx_streaming{};     /* read by the message handler thread */
     bool cal_enabled{};
-    bool dual_port{};
     bool rx_second{};
+    bool radio_configured{};         /* false while the settings are only staged */
 
     /* work parameters */
     uint64_t last_status_update_sample{};
     uint64_t status_update_rate_in_samples{};
     uint64_t overrun_counter{};
-    bool first_block[MAX_PORT]{};
-    uint64_t last_timestamp[MAX_PORT]{};
+    bool zero_fill{};
     double adc_scaling{};
-    int16_t *curr_block_ptr[MAX_PORT]{};
-    int32_t curr_block_samples_left[MAX_PORT]{};
-
-    gr::tag_t curr_rf_block_tag{};
-
-    uint64_t last_tag_index[MAX_PORT]{};
+    int32_t rx_block_size{};     /* samples per DMA block for the stream mode */
+
+    /* per port receive state, indexed by output port */
+    struct rx_port_state {
+        uint8_t card{};
+        skiq_rx_hdl_t hdl{};
+        bool first_block{};
+        uint64_t last_timestamp{};
+        uint64_t fill_samples_left{};
+        uint64_t overrun_lost_samples{};
+        bool overrun_tag_pending{};
+        std::vector<int16_t> unpack_buffer;   /* packed mode blocks are unpacked here */
+        int16_t *curr_block_ptr{};
+        int32_t curr_block_samples_left{};
+        uint64_t curr_timestamp{};             /* rf_timestamp of curr_block_ptr */
+
+        /* with several ports, a block for a port that still has samples or a full output is
+         * copied to its backlog, and what is left of a block in receive memory is copied to
+         * carry_buffer before the next receive can reuse that memory */
+        std::unique_ptr<rx_block_ring> backlog;
+        bool backlog_slot_held{};
+        bool block_in_receive_memory{};        /* curr_block_ptr points into the last received block */
+        std::vector<int16_t> carry_buffer;
+
+        /* rx_freq and rx_gain tags waiting for their sample, the offset holds the rf_timestamp.
+         * A fixed ring so work() does not allocate, work() is both sides of it */
+        spsc_ring<gr::tag_t> setting_tags{SETTING_TAG_DEPTH};
+
+        /* the rf_timestamp tag goes on the first sample of each block */
+        gr::tag_t rf_block_tag{};
+        bool rf_tag_pending{};
+
+        /* settings last written to this handle, unchanged settings are not written again */
+        bool hw_rate_valid{};
+        uint32_t hw_sample_rate{};
+        uint32_t hw_bandwidth{};
+        uint64_t hw_frequency{};         /* 0 until written */
+        int32_t hw_gain_mode{-1};        /* -1 until written */
+        int32_t hw_gain{-1};
+        int32_t hw_cal_mode{-1};
+        int64_t hw_cal_mask{-1};
+    };
+    rx_port_state ports[MAX_OUTPUTS];
+    uint32_t num_ports{};
+    int32_t hdl_to_port[MAX_CARDS][skiq_rx_hdl_end]{};   /* output port of each card index and handle, -1 if not streaming */
+
+    /* with several cards, every port starts on align_timestamp */
+    bool align_pending{};
+    uint64_t align_timestamp{};
+
+    /* capture thread, drains skiq_receive() into capture_ring when enabled */
+    uint32_t capture_blocks{};
+    std::unique_ptr<rx_block_ring> capture_ring;
+    std::thread capture_thread;
+    std::atomic<bool> capture_running{};
+    std::atomic<int32_t> capture_status{};
+    bool capture_slot_held{};
+    uint64_t last_capture_dropped{};
+    uint64_t last_backlog_dropped{};
+
+    /* when another RX block streams from one of the cards, the rx_dispatcher receives for
+     * every card of this block and each card's blocks arrive in dispatch_rings[card index] */
+    bool dispatched{};
+    std::unique_ptr<rx_block_ring> dispatch_rings[MAX_CARDS];
+    int32_t dispatch_slot_held{-1};
+
+    /* receive strategy, only touched by the thread calling skiq_receive() */
+    uint32_t rx_strategy{};
+    uint32_t next_card{};    /* index of the card skiq_receive() tries first */
+    bool adaptive_blocking{};
+    bool adaptive_spinning{};
+    std::chrono::steady_clock::time_point adaptive_spin_start{};
+
+    /* CPU load of the receiving thread, reported with the status update */
+    bool cpu_report_valid{};
+    double last_cpu_seconds{};
+    std::chrono::steady_clock::time_point last_cpu_report_time{};
 
     /* used to debug the work function */
     uint32_t debug_ctr{};
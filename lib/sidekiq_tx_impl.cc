@@ -8,56 +8,39 @@
 #include <volk/volk.h>
 #include <boost/algorithm/string.hpp>
 #include <boost/foreach.hpp>
-#include <pthread.h>
+#include <algorithm>
+#include <fstream>
+#include <numeric>
 
 #include "sidekiq_tx_impl.h"
+#include "iq_pack.h"
+#include "iq_convert.h"
 
 
 #define DEBUG_LEVEL "debug"  //Can be debug, info, warning, error, critical
 
-/* The tx_complete function needs to be outside the object so it can be registered with libsidekiq 
- * mutex to protect updates to the tx buffer
- * Any parameters it uses also needs to be global and accessible inside and outside the function.
- */
-static pthread_mutex_t tx_buf_mutex;
-  
-static uint32_t complete_count{};
-
-/* mutex and condition variable to signal when the tx queue may have room available */
-static pthread_mutex_t space_avail_mutex;
-static pthread_cond_t space_avail_cond;
-
 /* 
  * When in async mode this is called after each block is completed by libsidekiq 
  *
- * This is outside the class since it is called by libsidekiq
+ * This is outside the class since it is called by libsidekiq.  Each block is transmitted 
+ * with its entry in the owning instance's block pool as p_user, so nothing here is shared 
+ * between TX blocks.
  */
 static void tx_complete( int32_t status, skiq_tx_block_t *p_data, void *p_user )
 {
+    (void)(p_data);
+
     /* -2 happens when there are outstanding buffers and we stop streaming */
     if( status != 0 && status != -2)
     {
-        fprintf(stderr, "Error: packet %" PRIu32 " failed with status %d\n",
-                complete_count, status);
+        fprintf(stderr, "Error: TX block failed with status %d\n", status);
     }
 
-    // increment the packet completed count
-    complete_count++;
-
-    pthread_mutex_lock( &tx_buf_mutex );
-    // update the in use status of the packet just completed
+    /* the block can be filled again */
     if (p_user)
     {
-        *(int32_t*)p_user = 0;
+        gr::sidekiq::tx_block_pool::complete(p_user);
     }
-     pthread_mutex_unlock( &tx_buf_mutex );
-
-    // signal to the other thread that there may be space available now that a
-    // packet send has completed
-    pthread_mutex_lock( &space_avail_mutex );
-    pthread_cond_signal(&space_avail_cond);
-    pthread_mutex_unlock( &space_avail_mutex );
-
 }
 
 namespace gr {
@@ -75,7 +58,16 @@ sidekiq_tx::sptr sidekiq_tx::make(int card,
                                   std::string burst_tag,
                                   int threads,
                                   int buffer_size,
-                                  int cal_mode)
+                                  int cal_mode,
+                                  int packed_mode,
+                                  int queue_depth,
+                                  int timestamp_mode,
+                                  int burst_mode,
+                                  int latency_mode,
+                                  int handle2,
+                                  int input_format,
+                                  int cyclic_mode,
+                                  std::string cyclic_file)
 {
     /* then make instantiates the tx_block */
     return gnuradio::make_block_sptr<sidekiq_tx_impl>(
@@ -88,7 +80,16 @@ sidekiq_tx::sptr sidekiq_tx::make(int card,
                                   burst_tag,
                                   threads,
                                   buffer_size,
-                                  cal_mode);
+                                  cal_mode,
+                                  packed_mode,
+                                  queue_depth,
+                                  timestamp_mode,
+                                  burst_mode,
+                                  latency_mode,
+                                  handle2,
+                                  input_format,
+                                  cyclic_mode,
+                                  cyclic_file);
 }
 
 
@@ -104,9 +105,19 @@ sidekiq_tx_impl::sidekiq_tx_impl( int input_card,
                                   std::string burst_tag,
                                   int threads,
                                   int buffer_size, 
-                                  int cal_mode)
+                                  int cal_mode,
+                                  int packed_mode,
+                                  int queue_depth,
+                                  int timestamp_mode,
+                                  int burst_mode,
+                                  int latency_mode,
+                                  int handle2,
+                                  int input_format,
+                                  int cyclic_mode,
+                                  std::string cyclic_file)
     : gr::sync_block("sidekiq_tx",
-                     gr::io_signature::make( 1 /* min inputs */, 1 /* max inputs */, sizeof(gr_complex)),
+                     gr::io_signature::make( 1 /* min inputs */, MAX_TX_CHANNELS /* max inputs */, 
+                                             input_item_size_for(input_format)),
                      gr::io_signature::make(0, 0, 0))   //sync block
 {
     std::string str;
@@ -122,12 +133,45 @@ sidekiq_tx_impl::sidekiq_tx_impl( int input_card,
 
     card = input_card;
     hdl = (skiq_tx_hdl_t)handle;
+
+    /* the second input goes to the other handle of the pair, both are sent in one block */
+    if (handle2 == NO_HANDLE)
+    {
+        num_channels = 1;
+    }
+    else if ((handle == skiq_tx_hdl_A1 && handle2 == skiq_tx_hdl_A2) || 
+             (handle == skiq_tx_hdl_B1 && handle2 == skiq_tx_hdl_B2))
+    {
+        num_channels = 2;
+        hdl2 = (skiq_tx_hdl_t)handle2;
+    }
+    else
+    {
+        d_logger->error( "Error: handle2 {} can not be paired with handle {}, use A1/A2 or B1/B2", 
+                handle2, handle);
+        throw std::runtime_error("Failure: handle2");
+    }
     curr_block = 0;
     tx_buffer_size = buffer_size;
-    temp_buffer.resize(tx_buffer_size);
-    num_blocks = NUM_BLOCKS;
+    num_blocks = queue_depth;
+
+    /* a packed block holds 4 samples in every 3 words */
+    this->packed_mode = (packed_mode != 0);
+    if (this->packed_mode == true)
+    {
+        tx_block_samples = packed_samples_in_words(tx_buffer_size);
+        pack_buffer.resize(tx_block_samples);
+    }
+    else
+    {
+        tx_block_samples = tx_buffer_size;
+    }
+    d_logger->info("Info: TX sample conversion using {} kernel", scale_convert_kernel_name());
 
     burst_tag_name = burst_tag;
+    burst_tag_key = pmt::string_to_symbol(burst_tag_name);
+    _tags.reserve(TAG_RESERVE_COUNT);
+    _burst_tags.reserve(TAG_RESERVE_COUNT);
     d_logger->debug("burst_tag_name: {}", burst_tag_name);   
 
     if( 0 == burst_tag_name.compare("") )
@@ -139,33 +183,103 @@ sidekiq_tx_impl::sidekiq_tx_impl( int input_card,
         bursting_cmd = BURSTING_OFF;
     }
 
-    status = skiq_init(skiq_xport_type_pcie, skiq_xport_init_level_full, &card, 1);
-    if (status != 0) 
+    /* continuous bursting keeps the stream up between bursts instead of starting and stopping it */
+    if (burst_mode == BURST_MODE_START_STOP)
     {
-        if (status != -EEXIST)
-        {
-            d_logger->error( "Error: unable to initialize libsidekiq with status {}", status);
-            throw std::runtime_error("Failure: skiq_init");
-        }
-        else 
+        continuous_bursts = false;
+    }
+    else if (burst_mode == BURST_MODE_CONTINUOUS)
+    {
+        continuous_bursts = true;
+    }
+    else
+    {
+        d_logger->error( "Error: invalid burst_mode {}", burst_mode);
+        throw std::runtime_error("Failure: burst_mode");
+    }
+
+    /* low latency lets work() run with less than a block of input */
+    if (latency_mode == LATENCY_MODE_FULL_BLOCKS)
+    {
+        low_latency = false;
+    }
+    else if (latency_mode == LATENCY_MODE_LOW)
+    {
+        low_latency = true;
+    }
+    else
+    {
+        d_logger->error( "Error: invalid latency_mode {}", latency_mode);
+        throw std::runtime_error("Failure: latency_mode");
+    }
+
+    /* cyclic playback repeats a loaded waveform on its own thread, the input is dropped */
+    if (cyclic_mode == CYCLIC_MODE_OFF)
+    {
+        this->cyclic_mode = false;
+    }
+    else if (cyclic_mode == CYCLIC_MODE_ON)
+    {
+        this->cyclic_mode = true;
+        if (timestamp_mode != TX_TIMESTAMP_MODE_OFF)
         {
-            d_logger->info("Info: If not running Transceive Mode, then this is an error");
-            tx_second = true;
+            d_logger->error( "Error: cyclic mode can not be used with timed TX");
+            throw std::runtime_error("Failure: cyclic_mode");
         }
     }
     else
     {
-        libsidekiq_init = true;
-        d_logger->info("Info: libsidkiq initialized successfully");
+        d_logger->error( "Error: invalid cyclic_mode {}", cyclic_mode);
+        throw std::runtime_error("Failure: cyclic_mode");
+    }
+
+    /* immediate mode sends blocks as they arrive, timestamp mode holds each block until 
+     * its timestamp and the FPGA drops blocks that are already late */
+    if (timestamp_mode == TX_TIMESTAMP_MODE_OFF)
+    {
+        timed_tx = false;
+    }
+    else if (timestamp_mode == TX_TIMESTAMP_MODE_ON)
+    {
+        timed_tx = true;
+    }
+    else
+    {
+        d_logger->error( "Error: invalid timestamp_mode {}", timestamp_mode);
+        throw std::runtime_error("Failure: timestamp_mode");
+    }
 
+    if (queue_depth < 1)
+    {
+        d_logger->error( "Error: invalid queue_depth {}", queue_depth);
+        throw std::runtime_error("Failure: queue_depth");
     }
 
-    if (tx_second == false)
+    /* every argument is checked by now.  If anything below throws the destructor never runs,
+     * so the guard frees what was allocated and gives the card back */
+    card_guard<sidekiq_tx_impl> guard(this, &sidekiq_tx_impl::release_card);
+
+    /* enable the card, libsidekiq is shared with any other sidekiq block in the process */
+    status = card_manager::instance().acquire(&card, 1, &tx_second);
+    if (status != 0) 
     {
-        set_tx_sample_rate(sample_rate);
-        set_tx_bandwidth(bandwidth);
+        d_logger->error( "Error: unable to initialize libsidekiq with status {}", status);
+        throw std::runtime_error("Failure: skiq_init");
+    }
+    libsidekiq_init = true;
+    if (tx_second == true)
+    {
+        d_logger->info("Info: sharing the card with another sidekiq block");
+    }
+    else
+    {
+        d_logger->info("Info: libsidkiq initialized successfully");
     }
 
+    /* the radio settings are staged here and written once, in order, by start() */
+    set_tx_sample_rate(sample_rate);
+    set_tx_bandwidth(bandwidth);
+
     status = skiq_read_tx_iq_resolution(card, &iq_resolution);
     if (status != 0) 
     {
@@ -175,32 +289,37 @@ sidekiq_tx_impl::sidekiq_tx_impl( int input_card,
     dac_scaling = (pow(2.0f, iq_resolution) / 2.0)-1;
     d_logger->info("Info: dac scaling {}", dac_scaling);
 
-    /* always use immediate mode */
-    status = skiq_write_tx_data_flow_mode(card, hdl, skiq_tx_immediate_data_flow_mode);
+    /* sc16 input skips the float conversion, full scale input only needs a shift */
+    input_sc16 = (input_format != INPUT_FORMAT_FC32);
+    input_item_size = input_item_size_for(input_format);
+    if (input_format == INPUT_FORMAT_SC16_FULL && iq_resolution < 16)
+    {
+        input_shift = 16 - iq_resolution;
+    }
+    if (input_sc16 == true)
+    {
+        d_logger->info("Info: sc16 input, shifted down by {} bits", input_shift);
+    }
+
+    status = skiq_write_tx_data_flow_mode(card, hdl, 
+            timed_tx ? skiq_tx_with_timestamps_data_flow_mode : skiq_tx_immediate_data_flow_mode);
     if (status != 0) 
     {
         d_logger->error( "Error: could not set TX dataflow mode with status {}", status);
         throw std::runtime_error("Failure: skiq_write_tx_flow_mode");
     }
+    _time_tags.reserve(TAG_RESERVE_COUNT);
 
-    /* if A2 or B2 is used, we need to set the channel mode to dual */
-    if (hdl == skiq_tx_hdl_A2 || hdl == skiq_tx_hdl_B2) 
+    /* if A2 or B2 is used, we need to set the channel mode to dual.  The mode is card wide, 
+     * so an RX block on the card that needs dual mode keeps it */
+    bool dual_chan = (hdl == skiq_tx_hdl_A2 || hdl == skiq_tx_hdl_B2 || num_channels == 2);
+    status = card_manager::instance().set_chan_mode(card, dual_chan);
+    if (status != 0) 
     {
-        status = skiq_write_chan_mode(card, skiq_chan_mode_dual);
-        if (status != 0) 
-        {
-            d_logger->error( "Error: unable to configure TX channel mode with status {}", status);
-            throw std::runtime_error("Failure: skiq_write_chan_mode");
-        }
-    } 
-    else {
-        status = skiq_write_chan_mode(card, skiq_chan_mode_single);
-        if (status != 0) 
-        {
-            d_logger->error( "Error: unable to configure TX channel mode with status {}", status);
-            throw std::runtime_error("Failure: skiq_write_chan_mode");
-        }
+        d_logger->error( "Error: unable to configure TX channel mode with status {}", status);
+        throw std::runtime_error("Failure: skiq_write_chan_mode");
     }
+    dual_chan_held = dual_chan;
 
     /* write the block size to the passed in amount */
     status = skiq_write_tx_block_size(card, hdl, tx_buffer_size);
@@ -210,11 +329,13 @@ sidekiq_tx_impl::sidekiq_tx_impl( int input_card,
                 tx_buffer_size, status);
         throw std::runtime_error("Failure: skiq_write_tx_block_size");
     }
-    d_logger->info("Info: TX block size {}", tx_buffer_size);
+    d_logger->info("Info: TX block size {}, {} channel(s)", tx_buffer_size, num_channels);
 
     /* handle sync vs async mode */
-    if (threads > 1)
+    /* the playback thread sends each block synchronously so it can be sent again right away */
+    if (threads > 1 && this->cyclic_mode == false)
     {  
+        in_async_mode = true;
         status = skiq_write_tx_transfer_mode(card, hdl, skiq_tx_transfer_mode_async);
         if (status != 0) 
         {
@@ -235,34 +356,36 @@ sidekiq_tx_impl::sidekiq_tx_impl( int input_card,
             d_logger->error( "Error: unable to configure TX callback with status {}", status);
             throw std::runtime_error("Failure: skiq_register_tx_complete_callback");
         }
-        d_logger->info("Info: in async mode with {} threads", threads);
+        d_logger->info("Info: in async mode with {} threads, {} blocks queued", threads, num_blocks);
     }
     else {
+        in_async_mode = false;
         status = skiq_write_tx_transfer_mode(card, hdl, skiq_tx_transfer_mode_sync);
         if (status != 0) 
         {
             d_logger->error( "Error: unable to configure TX channel mode with status {}", status);
             throw std::runtime_error("Failure: skiq_write_tx_transfer_mode");
         }
-        num_blocks = 1;
-        d_logger->info("Info: in sync mode ");
+        /* the submission thread needs a queue of blocks, cyclic mode has its own */
+        use_submit_thread = (this->cyclic_mode == false);
+        if (use_submit_thread == false)
+        {
+            num_blocks = 1;
+        }
+        d_logger->info("Info: in sync mode, {} blocks queued to the submission thread", 
+                use_submit_thread ? num_blocks : 0);
     }
 
-    /* always assume unpacked */ 
-    status = skiq_write_iq_pack_mode(card, SIDEKIQ_IQ_PACK_MODE_UNPACKED);
+    /* packed mode is card wide, it has to match the RX block in transceive mode.  The card 
+     * manager already switched the card to I/Q order */ 
+    status = card_manager::instance().set_pack_mode(card, 
+            this->packed_mode ? SIDEKIQ_IQ_PACK_MODE_PACKED : SIDEKIQ_IQ_PACK_MODE_UNPACKED);
     if (status != 0) 
     {
-        d_logger->error( "Error: unable to set iq pack mode to unpacked with status {}", status);
+        d_logger->error( "Error: unable to set iq pack mode to {} with status {}, "
+                "it has to match any other block on card {}", packed_mode, status, card);
         throw std::runtime_error("Failure: skiq_write_iq_pack_mode");
     }
- 
-    /* by default all cards are in Q/I order we want it to be I/Q so switch it */ 
-    status = skiq_write_iq_order_mode(card, skiq_iq_order_iq) ;
-    if (status != 0) 
-    {
-          d_logger->error( "Error: unable to set iq order mode to iq with status {} ", status);
-          throw std::runtime_error("Failure: skiq_write_iq_pack_mode");
-    }
 
     /* allocate memory to hold the pointers for the tx blocks */
     p_tx_blocks = (skiq_tx_block_t **)calloc( num_blocks, sizeof( skiq_tx_block_t * ));
@@ -272,30 +395,41 @@ sidekiq_tx_impl::sidekiq_tx_impl( int input_card,
         throw std::runtime_error("Failure: calloc p_tx_blocks");
     }
 
-    /* allocate memory to hold the status for each block */
-    p_tx_status = (int32_t *)calloc( num_blocks, sizeof(*p_tx_status) );
-    if( p_tx_status == NULL )
+    /* every block starts out free, the completion callback gives them back */
+    block_pool.reset(new tx_block_pool(num_blocks));
+    block_held = false;
+
+    /* room for every block plus the stream starts and stops between them */
+    if (use_submit_thread == true)
     {
-        d_logger->error( "Error: failed to allocate memory for TX status.");
-        throw std::runtime_error("Failure: calloc p_tx_status");
+        submit_queue.reset(new tx_submit_queue(num_blocks * 2));
     }
 
     /* ask libsidekiq to allocate each block */ 
     for (uint32_t i = 0; i < num_blocks; i++)
     {
-        /* allocate a transmit block by number of words */
-        p_tx_blocks[i] = skiq_tx_block_allocate( tx_buffer_size );
-        p_tx_status[i] = 0;
+        /* allocate a transmit block by number of words, in dual channel mode the block 
+         * holds the first channel's words followed by the second's */
+        p_tx_blocks[i] = skiq_tx_block_allocate( tx_buffer_size * num_channels );
     }
 
     message_port_register_in(CONTROL_MESSAGE_PORT);
     set_msg_handler(CONTROL_MESSAGE_PORT, [this](pmt::pmt_t msg) { this->handle_control_message(msg); });
 
-    /* set the frequency and attenuation */
+    message_port_register_in(WAVEFORM_MESSAGE_PORT);
+    set_msg_handler(WAVEFORM_MESSAGE_PORT, [this](pmt::pmt_t msg) { this->handle_waveform_message(msg); });
+
+    /* stage the frequency and attenuation */
     set_tx_frequency(frequency);
     set_tx_attenuation(attenuation);
     set_tx_cal_mode(cal_mode);
 
+    if (this->cyclic_mode == true && cyclic_file.empty() == false)
+    {
+        load_cyclic_file(cyclic_file);
+    }
+
+    guard.dismiss();
 }
 
 /* Destructor, free all the memory allocated */
@@ -303,26 +437,48 @@ sidekiq_tx_impl::~sidekiq_tx_impl()
 {
     d_logger->debug("in TX destructor");
 
-    for (uint32_t i = 0; i < num_blocks; i++)
+    release_card();
+}
+
+/*
+ * release_card
+ *
+ * Frees the TX blocks and gives back the dual channel request and the reference to the card.
+ * It only touches what was allocated, so it is safe part way through the constructor.
+ */
+void sidekiq_tx_impl::release_card()
+{
+    /* the cyclic blocks have to go before libsidekiq does */
+    stop_playback_thread();
+    stop_submit_thread();
+    cyclic_blocks.reset();
+
+    for (uint32_t i = 0; (p_tx_blocks != NULL) && (i < num_blocks); i++)
     {
-        /* allocate a transmit block by number of words */
-        skiq_tx_block_free(p_tx_blocks[i]);
+        /* a constructor that threw may not have allocated every block */
+        if (p_tx_blocks[i] != NULL)
+        {
+            skiq_tx_block_free(p_tx_blocks[i]);
+        }
     }
 
     if (p_tx_blocks != NULL)
     {
         free(p_tx_blocks);
+        p_tx_blocks = NULL;
     }
 
-    if (p_tx_status != NULL)
+    if (dual_chan_held == true)
     {
-        free(p_tx_status);
+        card_manager::instance().release_dual_chan(card);
+        dual_chan_held = false;
     }
 
-    /* disable libsidekiq */
+    /* libsidekiq only exits when the last block using it lets go */
     if (libsidekiq_init == true)
     {
-        skiq_exit();
+        card_manager::instance().release(&card, 1);
+        libsidekiq_init = false;
     }
 }
 
@@ -355,17 +511,28 @@ void sidekiq_tx_impl::handle_control_message(pmt_t msg)
          return;
      }
 
+    /* only the RX stream has an rf_timestamp to line a command up with */
+    if (pmt::dict_has_key(msg, TIME_KEY))
+    {
+        d_logger->warn("Warning: TX commands can not be timed, the command is applied now");
+    }
+
     if (pmt::dict_has_key(msg, LO_FREQ_KEY)) 
     {
         set_tx_frequency(get_double_from_pmt_dict(msg, LO_FREQ_KEY));
     }
 
-    if (pmt::dict_has_key(msg, RATE_KEY)) 
+    /* a rate and a bandwidth in the same message are written together */
+    if (pmt::dict_has_key(msg, RATE_KEY) && pmt::dict_has_key(msg, BANDWIDTH_KEY)) 
+    {
+        write_rate_and_bandwidth(static_cast<uint32_t>(get_double_from_pmt_dict(msg, RATE_KEY)),
+                static_cast<uint32_t>(get_double_from_pmt_dict(msg, BANDWIDTH_KEY)));
+    }
+    else if (pmt::dict_has_key(msg, RATE_KEY)) 
     {
         set_tx_sample_rate(get_double_from_pmt_dict(msg, RATE_KEY));
     }
-
-    if (pmt::dict_has_key(msg, BANDWIDTH_KEY)) 
+    else if (pmt::dict_has_key(msg, BANDWIDTH_KEY)) 
     {
         set_tx_bandwidth(get_double_from_pmt_dict(msg, BANDWIDTH_KEY));
     }
@@ -377,23 +544,70 @@ void sidekiq_tx_impl::handle_control_message(pmt_t msg)
 }
 
 
-/* start streaming */
-bool sidekiq_tx_impl::start() 
+/* 
+ * the input signature has to be known before the constructor body runs 
+ */
+size_t sidekiq_tx_impl::input_item_size_for(int input_format)
 {
-    int status = 0;
+    if (input_format == INPUT_FORMAT_FC32)
+    {
+        return sizeof(gr_complex);
+    }
+    else if (input_format == INPUT_FORMAT_SC16 || input_format == INPUT_FORMAT_SC16_FULL)
+    {
+        return sizeof(int16_t) * IQ_SHORT_COUNT;
+    }
 
+    throw std::runtime_error("Failure: invalid input_format");
+}
+
+/* one input per channel, handle2 decides if there is a second */
+bool sidekiq_tx_impl::check_topology(int ninputs, int noutputs)
+{
+    (void)(noutputs);
+
+    if (ninputs != (int)num_channels)
+    {
+        d_logger->error( "Error: {} inputs connected, {} channel(s) configured", ninputs, num_channels);
+        return false;
+    }
+
+    return true;
+}
+
+/* start streaming, in dual channel mode the first handle streams both channels */
+bool sidekiq_tx_impl::start() 
+{
     d_logger->debug("in start() cmd {}", bursting_cmd);
 
-    if (bursting_cmd == BURSTING_ON || bursting_cmd == NO_BURSTING_ENABLED)
+    auto start_time = std::chrono::steady_clock::now();
+    apply_radio_config();
+
+    /* bursts start the stream later, through the submission thread */
+    if (use_submit_thread == true && submit_thread.joinable() == false)
     {
-        status = skiq_start_tx_streaming(card, hdl);
-        if (status != 0)
+        submit_queue->reset();
+        submit_status = 0;
+        submit_running = true;
+        submit_thread = std::thread(&sidekiq_tx_impl::submit_loop, this);
+        d_logger->info("Info: TX submission thread started");
+    }
+
+    if (bursting_cmd == BURSTING_ON || bursting_cmd == NO_BURSTING_ENABLED || continuous_bursts == true ||
+            cyclic_mode == true)
+    {
+        start_streaming();
+
+        if (cyclic_mode == true && playback_thread.joinable() == false)
         {
-            d_logger->error( "Error: could not start TX streaming, status {}", status);
-            throw std::runtime_error("Failure: skiq_start_tx_streaming");
+            playback_status = 0;
+            playback_running = true;
+            playback_thread = std::thread(&sidekiq_tx_impl::playback_loop, this);
+            d_logger->info("Info: TX cyclic playback thread started");
         }
 
-        tx_streaming = true;
+        d_logger->info("Info: TX streaming started in {:.1f} ms", 
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count());
 
         return block::start();
     }
@@ -403,14 +617,83 @@ bool sidekiq_tx_impl::start()
     }
 }
 
+/* write the settings staged since the constructor, once per handle.  Sample rate and 
+ * bandwidth go in a single write.  In transceive mode the rate was already set by the 
+ * block that opened the card.  After this the setters write to the card directly */
+void sidekiq_tx_impl::apply_radio_config()
+{
+    if (radio_configured == true)
+    {
+        return;
+    }
+
+    auto config_start = std::chrono::steady_clock::now();
+
+    /* the setters write to the card once this is set */
+    radio_configured = true;
+
+    try
+    {
+        /* the TX handle has its own rate even when an RX block shares the card, the shadow
+         * skips the write when the handle already has it */
+        write_rate_and_bandwidth(sample_rate, bandwidth);
+        set_tx_frequency(frequency);
+        set_tx_attenuation(attenuation);
+        set_tx_cal_mode(calibration_mode);
+    }
+    catch (...)
+    {
+        /* a setter failed part way, the next start() writes every setting again */
+        radio_configured = false;
+        throw;
+    }
+
+    d_logger->info("Info: TX radio configured in {:.1f} ms", 
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - config_start).count());
+}
+
 /* stop streaming */
 bool sidekiq_tx_impl::stop() 
 {
-    int status = 0;
-    
     d_logger->debug("in stop() ");
 
-    if (tx_streaming == true)
+    /* the playback and submission threads may be in skiq_transmit(), they have to stop 
+     * before the stream does */
+    stop_playback_thread();
+    stop_submit_thread();
+
+    stop_streaming();
+
+    /* also covers a failure that came after the last call to work() */
+    if (playback_status != 0)
+    {
+        d_logger->error( "Error: cyclic playback ended with status {}", playback_status.load());
+        return false;
+    }
+
+    return block::stop();
+}
+
+void sidekiq_tx_impl::start_streaming()
+{
+    int status = 0;
+
+    status = skiq_start_tx_streaming(card, hdl);
+    if (status != 0)
+    {
+        d_logger->error( "Error: could not start TX streaming, status {}", status);
+        throw std::runtime_error("Failure: skiq_start_tx_streaming");
+    }
+
+    tx_streaming = true;
+    stream_running = true;
+}
+
+void sidekiq_tx_impl::stop_streaming()
+{
+    int status = 0;
+
+    if (stream_running == true)
     {
         status = skiq_stop_tx_streaming(card, hdl);
         if (status != 0)
@@ -418,38 +701,118 @@ bool sidekiq_tx_impl::stop()
             d_logger->error( "Error: could not stop TX streaming, status {}", status);
             throw std::runtime_error("Failure: skiq_start_tx_streaming");
         }
-        tx_streaming = false;
+        stream_running = false;
     }
 
-    
-
-    return block::stop();
+    tx_streaming = false;
 }
 
-/* set the sample rate 
- * this may be called from the flowgraph if the user changes the variable
+/* 
+ * queue_submit
+ *
+ * Hands an entry to the submission thread, waiting while the queue is full.
  */
-void sidekiq_tx_impl::set_tx_sample_rate(double value) 
+void sidekiq_tx_impl::queue_submit(uint32_t flags, uint32_t block)
 {
+    tx_submit_queue::entry e{flags, block};
 
-    int status = 0;
-    d_logger->debug("in set_tx_sample_rate() ");
+    for (;;)
+    {
+        uint64_t changes = submit_queue->changes();
 
-    auto rate = static_cast<uint32_t>(value);
-    auto bw = static_cast<uint32_t>(this->bandwidth);
+        if (submit_queue->push(e) == true)
+        {
+            return;
+        }
 
-    status = skiq_write_tx_sample_rate_and_bandwidth(card, hdl, rate, bw); 
-    if (status != 0) 
+        if (submit_status != 0)
+        {
+            d_logger->error( "Error: TX submission failed with status {}", submit_status.load());
+            throw std::runtime_error("Failure: skiq_transmit");
+        }
+
+        submit_queue->wait_change(changes, std::chrono::microseconds(TX_BLOCK_WAIT_TIMEOUT));
+    }
+}
+
+/*
+ * submit_loop
+ *
+ * Runs on the submission thread in sync mode.  Each block goes back to the pool once the 
+ * blocking skiq_transmit() returns.
+ */
+void sidekiq_tx_impl::submit_loop()
+{
+    tx_submit_queue::entry e{};
+
+    while (submit_running.load(std::memory_order_relaxed) == true)
     {
-        d_logger->error( "Error: could not set sample_rate, status {}, {}", 
-                status, strerror(abs(status)) );
-        throw std::runtime_error("Failure: set samplerate");
+        uint64_t changes = submit_queue->changes();
+        int32_t status = 0;
+
+        if (submit_queue->pop(&e) == false)
+        {
+            submit_queue->wait_change(changes, std::chrono::microseconds(TX_BLOCK_WAIT_TIMEOUT));
+            continue;
+        }
+
+        if (e.flags & tx_submit_queue::START_STREAM)
+        {
+            status = skiq_start_tx_streaming(card, hdl);
+            stream_running = (status == 0);
+        }
+
+        if (status == 0 && (e.flags & tx_submit_queue::SEND_BLOCK))
+        {
+            status = skiq_transmit(card, hdl, p_tx_blocks[e.block], NULL);
+            block_pool->release(e.block);
+        }
+
+        if (status == 0 && (e.flags & tx_submit_queue::STOP_STREAM))
+        {
+            status = skiq_stop_tx_streaming(card, hdl);
+            stream_running = false;
+        }
+
+        if (status != 0)
+        {
+            /* hand the failure to work() so it is reported on the scheduler thread */
+            submit_status = status;
+            break;
+        }
     }
+}
 
-    this->sample_rate = rate;
-    this->bandwidth = bw;
+/* whatever was still queued is dropped, its blocks go back to the pool */
+void sidekiq_tx_impl::stop_submit_thread()
+{
+    tx_submit_queue::entry e{};
+
+    submit_running = false;
+
+    if (submit_thread.joinable())
+    {
+        submit_thread.join();
+        d_logger->info("Info: TX submission thread stopped");
+
+        while (submit_queue->pop(&e) == true)
+        {
+            if (e.flags & tx_submit_queue::SEND_BLOCK)
+            {
+                block_pool->release(e.block);
+            }
+        }
+    }
+}
 
+/* set the sample rate 
+ * this may be called from the flowgraph if the user changes the variable
+ */
+void sidekiq_tx_impl::set_tx_sample_rate(double value) 
+{
+    d_logger->debug("in set_tx_sample_rate() ");
 
+    write_rate_and_bandwidth(static_cast<uint32_t>(value), this->bandwidth);
 }
   
 /* set the bandwidth
@@ -457,24 +820,43 @@ void sidekiq_tx_impl::set_tx_sample_rate(double value)
  */
 void sidekiq_tx_impl::set_tx_bandwidth(double value) 
 {
-    int status = 0;
     d_logger->debug("in set_tx_bandwidth() ");
 
-    auto rate = static_cast<uint32_t>(this->sample_rate);
-    auto bw = static_cast<uint32_t>(value);
+    write_rate_and_bandwidth(this->sample_rate, static_cast<uint32_t>(value));
+}
+
+/* libsidekiq sets both in one call, so a rate and a bandwidth change in the same control 
+ * message are written together.  Nothing is written if the card already has both values */
+void sidekiq_tx_impl::write_rate_and_bandwidth(uint32_t rate, uint32_t bw)
+{
+    int status = 0;
 
-    status = skiq_write_tx_sample_rate_and_bandwidth(card, hdl, rate, bw); 
-    if (status != 0) 
+    /* before start() the setting is only staged, apply_radio_config() writes it */
+    if (radio_configured == false)
     {
-        d_logger->error("Error: could not set bandwidth {}, status {}, {}", 
-                bw, status, strerror(abs(status)) );
-        throw std::runtime_error("Failure: set samplerate");
+        this->sample_rate = rate;
+        this->bandwidth = bw;
         return;
     }
 
+    if (written.rate_valid == false || written.sample_rate != rate || written.bandwidth != bw)
+    {
+        /* if the write fails the handle is in an unknown state */
+        written.rate_valid = false;
+        status = skiq_write_tx_sample_rate_and_bandwidth(card, hdl, rate, bw); 
+        if (status != 0) 
+        {
+            d_logger->error("Error: could not set sample_rate {} and bandwidth {}, status {}, {}", 
+                    rate, bw, status, strerror(abs(status)) );
+            throw std::runtime_error("Failure: set samplerate");
+        }
+        written.rate_valid = true;
+        written.sample_rate = rate;
+        written.bandwidth = bw;
+    }
+
     this->sample_rate = rate;
     this->bandwidth = bw;
-
 }
 
 /* set the LO frequency
@@ -487,6 +869,19 @@ void sidekiq_tx_impl::set_tx_frequency(double value)
 
     auto freq = static_cast<uint64_t>(value);
 
+    /* before start() the setting is only staged, apply_radio_config() writes it */
+    if (radio_configured == false)
+    {
+        this->frequency = freq;
+        return;
+    }
+
+    if (written.frequency == freq)
+    {
+        return;
+    }
+
+    written.frequency = 0;
     status = skiq_write_tx_LO_freq(card, hdl, freq);
     if (status != 0) 
     {
@@ -495,6 +890,7 @@ void sidekiq_tx_impl::set_tx_frequency(double value)
         throw std::runtime_error("Failure: set samplerate");
         return;
     }
+    written.frequency = freq;
 
     this->frequency = freq;
 }
@@ -510,16 +906,34 @@ void sidekiq_tx_impl::set_tx_attenuation(double value)
 
     auto att = static_cast<uint32_t>(value);
 
-    status = skiq_write_tx_attenuation(card, hdl, att);
-    if (status != 0)
+    /* before start() the setting is only staged, apply_radio_config() writes it */
+    if (radio_configured == false)
     {
-        d_logger->error( "Error: could not set TX attenuation to {} with status {}, {}", 
-                att, status, strerror(abs(status)) );
-        throw std::runtime_error("Failure: skiq_write_tx_attenuation");
+        this->attenuation = att;
         return;
     }
-    this->attenuation = att;
-}
+
+    /* both channels get the same attenuation */
+    for (uint32_t ch = 0; ch < num_channels; ch++)
+    {
+        if (written.attenuation[ch] == att)
+        {
+            continue;
+        }
+
+        written.attenuation[ch] = -1;
+        status = skiq_write_tx_attenuation(card, (ch == 0) ? hdl : hdl2, att);
+        if (status != 0)
+        {
+            d_logger->error( "Error: could not set TX attenuation to {} with status {}, {}", 
+                    att, status, strerror(abs(status)) );
+            throw std::runtime_error("Failure: skiq_write_tx_attenuation");
+            return;
+        }
+        written.attenuation[ch] = att;
+    }
+    this->attenuation = att;
+}
 
 /* set the cal_mode
  * this may be called from the flowgraph if the user changes the variable
@@ -530,12 +944,29 @@ void sidekiq_tx_impl::set_tx_cal_mode(int value)
     auto cal_mode = static_cast<skiq_tx_quadcal_mode_t>(value);
     d_logger->debug("in set_tx_cal_mode() ");
 
+    /* before start() the setting is only staged, apply_radio_config() writes it */
+    if (radio_configured == false)
+    {
+        this->calibration_mode = cal_mode;
+        return;
+    }
+
     // configure the calibration mode
-    status = skiq_write_tx_quadcal_mode( card, hdl, cal_mode );
-    if ( 0 != status )
+    for (uint32_t ch = 0; ch < num_channels; ch++)
     {
-        d_logger->error( "Error: unable to configure quadcal mode with {}", status);
-        throw std::runtime_error("Failure: skiq_write_tx_quadcal_mode");
+        if (written.cal_mode[ch] == cal_mode)
+        {
+            continue;
+        }
+
+        written.cal_mode[ch] = -1;
+        status = skiq_write_tx_quadcal_mode( card, (ch == 0) ? hdl : hdl2, cal_mode );
+        if ( 0 != status )
+        {
+            d_logger->error( "Error: unable to configure quadcal mode with {}", status);
+            throw std::runtime_error("Failure: skiq_write_tx_quadcal_mode");
+        }
+        written.cal_mode[ch] = cal_mode;
     }
 
     this->calibration_mode = cal_mode;
@@ -554,11 +985,14 @@ void sidekiq_tx_impl::run_tx_cal(int value)
         if (calibration_mode == skiq_tx_quadcal_mode_manual)
         {
             d_logger->info("Info: forcing calibration to run");
-            status = skiq_run_tx_quadcal( card, hdl );
-            if( status != 0 )
+            for (uint32_t ch = 0; ch < num_channels; ch++)
             {
-                d_logger->error( "Error: calibration failed to run properly ({})", status);
-                throw std::runtime_error("Failure: skiq_run_tx_quadcal");
+                status = skiq_run_tx_quadcal( card, (ch == 0) ? hdl : hdl2 );
+                if( status != 0 )
+                {
+                    d_logger->error( "Error: calibration failed to run properly ({})", status);
+                    throw std::runtime_error("Failure: skiq_run_tx_quadcal");
+                }
             }
         }
         else
@@ -575,7 +1009,38 @@ void sidekiq_tx_impl::forecast(int noutput_items, gr_vector_int &ninput_items_re
 {
 
     (void)(noutput_items);
-    ninput_items_required[0] = tx_buffer_size;
+
+    /* in low latency mode ask only for what the next block needs, the rest of a burst when
+     * it is shorter than a block, or a single sample so a waiting burst tag is seen right away.
+     * The zeros between continuous bursts still go out in whole blocks */
+    bool idle_fill = (bursting_cmd == BURSTING_OFF && continuous_bursts == true && timed_tx == false);
+
+    if (low_latency == false || idle_fill == true)
+    {
+        ninput_items_required[0] = tx_block_samples;
+    }
+    else if (bursting_cmd == BURSTING_ON && burst_length != 0)
+    {
+        uint64_t delta = burst_length - burst_samples_sent;
+
+        ninput_items_required[0] = (delta < (uint64_t)tx_block_samples) ? (int)delta : tx_block_samples;
+    }
+    else
+    {
+        ninput_items_required[0] = 1;
+    }
+
+    /* work() stopped short last time, do not call it again until there is more */
+    if (ninput_items_required[0] < input_items_wanted)
+    {
+        ninput_items_required[0] = input_items_wanted;
+    }
+
+    /* the channels are sent in lock step */
+    for (size_t i = 1; i < ninput_items_required.size(); i++)
+    {
+        ninput_items_required[i] = ninput_items_required[0];
+    }
 }
 
 /* This will determine if we received any more underruns than already reported 
@@ -600,6 +1065,362 @@ void sidekiq_tx_impl::update_tx_error_count() {
         printf("TX underrun count: %u\n", num_tx_errors);
         last_num_tx_errors = num_tx_errors;
 	}
+
+    /* in timestamp mode the FPGA drops blocks whose timestamp has already passed */
+    if (timed_tx == true)
+    {
+        uint32_t num_late = 0;
+
+        status = skiq_read_tx_num_late_timestamps(card, hdl, &num_late);
+        if (status != 0)
+        {
+            d_logger->error( "Error: skiq_read_tx_num_late_timestamps failed with status {} ", status);
+            throw std::runtime_error("Failure: skiq_read_tx_num_late_timestamps");
+        }
+
+        if (last_num_late != num_late || late_bursts != last_late_bursts)
+        {
+            d_logger->warn("TX late blocks dropped by the card: {}, late bursts dropped by the host: {}", 
+                    num_late, late_bursts);
+            last_num_late = num_late;
+            last_late_bursts = late_bursts;
+        }
+    }
+}
+
+/*
+ * tx_time_to_timestamp
+ *
+ * A tx_time tag holds either the RF timestamp as an integer, or a (full seconds, fractional
+ * seconds) tuple counted from when the timestamps were reset.
+ */
+uint64_t sidekiq_tx_impl::tx_time_to_timestamp(const pmt_t &value)
+{
+    if (pmt::is_tuple(value) && pmt::length(value) == 2)
+    {
+        double full_secs = static_cast<double>(pmt::to_uint64(pmt::tuple_ref(value, 0)));
+        double frac_secs = pmt::to_double(pmt::tuple_ref(value, 1));
+
+        return static_cast<uint64_t>(full_secs * sample_rate) + 
+                static_cast<uint64_t>(llround(frac_secs * sample_rate));
+    }
+
+    return pmt::to_uint64(value);
+}
+
+/*
+ * count_burst_samples
+ *
+ * Adds the samples just sent to the current burst and returns true once the burst is done.
+ * Only the start/stop burst mode stops streaming at the end of a burst.
+ */
+bool sidekiq_tx_impl::count_burst_samples(int32_t samples)
+{
+    if (burst_length == 0)
+    {
+        return false;
+    }
+
+    burst_samples_sent += samples;
+    if (burst_samples_sent < burst_length) 
+    {
+        return false;
+    }
+
+    d_logger->debug("done bursting, sent {}, length {}", burst_samples_sent, burst_length);
+    burst_length = 0;
+    burst_samples_sent = 0;
+    if (continuous_bursts == false)
+    {
+        /* with the submission thread the stream stops once the last block has gone out */
+        if (use_submit_thread == true)
+        {
+            queue_submit(tx_submit_queue::STOP_STREAM, 0);
+            tx_streaming = false;
+        }
+        else
+        {
+            stop_streaming();
+        }
+    }
+    bursting_cmd = BURSTING_OFF;
+
+    return true;
+}
+
+/*
+ * pad_block_tail
+ *
+ * A block always goes out whole, so the words after the last of samples are zeroed rather
+ * than sending whatever the block held the last time it was used.
+ */
+void sidekiq_tx_impl::pad_block_tail(int16_t *p_data, int32_t samples)
+{
+    int32_t words_used = samples;
+
+    if (samples >= tx_block_samples)
+    {
+        return;
+    }
+
+    if (packed_mode == true)
+    {
+        words_used = packed_words_for_samples(samples);
+    }
+
+    memset(&p_data[words_used * 2], 0, (tx_buffer_size - words_used) * sizeof(uint32_t));
+}
+
+/*
+ * fill_tx_channel
+ *
+ * Converts one channel's samples into its tx_buffer_size words of the block.  sc16 input
+ * already in the DAC range is copied, or packed straight from the input buffer.
+ */
+void sidekiq_tx_impl::fill_tx_channel(int16_t *p_data, const void *p_in, int32_t samples)
+{
+    const int16_t *p_iq = static_cast<const int16_t *>(p_in);
+
+    /* unpacked blocks take the int16 I/Q directly, packed ones need it staged first 
+     * unless the input can be used as is */
+    int16_t *p_dest = p_data;
+    if (packed_mode == true)
+    {
+        p_dest = reinterpret_cast<int16_t *>(&pack_buffer[0]);
+    }
+
+    if (input_sc16 == false)
+    {
+        /* scale, saturate and convert in one pass */
+        scale_convert_32fc_16ic(p_dest, static_cast<const float *>(p_in), dac_scaling, samples);
+        p_iq = p_dest;
+    }
+    else if (input_shift != 0)
+    {
+        shift_16ic(p_dest, p_iq, input_shift, samples);
+        p_iq = p_dest;
+    }
+    else if (packed_mode == false)
+    {
+        memcpy(p_data, p_iq, samples * input_item_size);
+    }
+
+    if (packed_mode == true)
+    {
+        /* squeeze each sample into 24 bits of the block */
+        pack_12bit_iq(reinterpret_cast<uint32_t *>(p_data), p_iq, samples);
+    }
+
+    pad_block_tail(p_data, samples);
+}
+
+/*
+ * cyclic playback
+ *
+ * The waveform is scaled and converted once into a ring of TX blocks.  When it does not end
+ * on a block boundary it is repeated until it does, so the cycles join without a gap, unless
+ * that takes more than CYCLIC_MAX_BLOCKS.  Then the last block is zero padded.  In dual channel
+ * mode both channels play the same waveform.
+ */
+sidekiq_tx_impl::cyclic_ring::~cyclic_ring()
+{
+    for (skiq_tx_block_t *p_block : blocks)
+    {
+        skiq_tx_block_free(p_block);
+    }
+}
+
+std::shared_ptr<sidekiq_tx_impl::cyclic_ring> 
+sidekiq_tx_impl::build_cyclic_ring(const std::vector<gr_complex> &waveform)
+{
+    auto ring = std::make_shared<cyclic_ring>();
+    uint64_t length = waveform.size();
+    uint64_t repeats = tx_block_samples / std::gcd(length, (uint64_t)tx_block_samples);
+    uint64_t num_blocks = (repeats * length) / tx_block_samples;
+    std::vector<gr_complex> staging(tx_block_samples);
+    std::vector<int16_t> iq(tx_block_samples * IQ_SHORT_COUNT);
+
+    if (num_blocks > CYCLIC_MAX_BLOCKS)
+    {
+        repeats = 1;
+        num_blocks = (length + tx_block_samples - 1) / tx_block_samples;
+        d_logger->info("Info: cyclic waveform of {} samples is zero padded to {} blocks", length, num_blocks);
+    }
+    ring->samples = repeats * length;
+
+    for (uint64_t b = 0; b < num_blocks; b++)
+    {
+        uint64_t start = b * tx_block_samples;
+        int32_t samples = std::min<uint64_t>(tx_block_samples, ring->samples - start);
+
+        skiq_tx_block_t *p_block = skiq_tx_block_allocate(tx_buffer_size * num_channels);
+        if (p_block == NULL)
+        {
+            d_logger->error( "Error: failed to allocate cyclic TX block {} of {}", b, num_blocks);
+            throw std::runtime_error("Failure: skiq_tx_block_allocate");
+        }
+        ring->blocks.push_back(p_block);
+
+        for (int32_t i = 0; i < samples; i++)
+        {
+            staging[i] = waveform[(start + i) % length];
+        }
+        scale_convert_32fc_16ic(&iq[0], reinterpret_cast<const float *>(&staging[0]), dac_scaling, samples);
+
+        for (uint32_t ch = 0; ch < num_channels; ch++)
+        {
+            int16_t *p_data = &p_block->data[ch * tx_buffer_size * 2];
+
+            if (packed_mode == true)
+            {
+                pack_12bit_iq(reinterpret_cast<uint32_t *>(p_data), &iq[0], samples);
+            }
+            else
+            {
+                memcpy(p_data, &iq[0], samples * IQ_SHORT_COUNT * sizeof(int16_t));
+            }
+            pad_block_tail(p_data, samples);
+        }
+    }
+
+    return ring;
+}
+
+void sidekiq_tx_impl::set_cyclic_waveform(const std::vector<gr_complex> &waveform)
+{
+    if (cyclic_mode == false)
+    {
+        d_logger->error( "Error: a cyclic waveform needs cyclic mode");
+        throw std::runtime_error("Failure: set_cyclic_waveform");
+    }
+
+    if (waveform.empty() == true)
+    {
+        d_logger->error( "Error: cyclic waveform is empty");
+        throw std::runtime_error("Failure: set_cyclic_waveform");
+    }
+
+    /* convert outside the lock, the playback thread only waits for the swap */
+    auto ring = build_cyclic_ring(waveform);
+    d_logger->info("Info: cyclic waveform of {} samples in {} blocks", waveform.size(), ring->blocks.size());
+
+    {
+        std::lock_guard<std::mutex> lock(cyclic_mutex);
+        cyclic_blocks = ring;
+    }
+    cyclic_cond.notify_all();
+}
+
+/* a raw gr_complex file, the same format a File Sink writes */
+void sidekiq_tx_impl::load_cyclic_file(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (file.is_open() == false)
+    {
+        d_logger->error( "Error: could not open cyclic file {}", filename);
+        throw std::runtime_error("Failure: cyclic_file");
+    }
+
+    std::vector<gr_complex> waveform(file.tellg() / sizeof(gr_complex));
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(waveform.data()), waveform.size() * sizeof(gr_complex));
+
+    set_cyclic_waveform(waveform);
+}
+
+/* the waveform port takes a c32vector or a PDU holding one */
+void sidekiq_tx_impl::handle_waveform_message(pmt_t msg)
+{
+    if (pmt::is_pair(msg) && !pmt::is_dict(msg))
+    {
+        msg = pmt::cdr(msg);
+    }
+
+    if (!pmt::is_c32vector(msg))
+    {
+        d_logger->error("waveform message is not a c32vector or PDU: {}", msg);
+        return;
+    }
+
+    size_t length = 0;
+    const gr_complex *p_samples = pmt::c32vector_elements(msg, length);
+    set_cyclic_waveform(std::vector<gr_complex>(p_samples, p_samples + length));
+}
+
+void sidekiq_tx_impl::playback_loop()
+{
+    std::shared_ptr<cyclic_ring> ring;
+
+    while (playback_running.load(std::memory_order_relaxed) == true)
+    {
+        /* take the newest waveform at the start of each cycle, wait if there is none yet */
+        {
+            std::unique_lock<std::mutex> lock(cyclic_mutex);
+            cyclic_cond.wait(lock, [this] { 
+                    return cyclic_blocks != nullptr || playback_running.load() == false; });
+            ring = cyclic_blocks;
+        }
+
+        for (size_t i = 0; ring != nullptr && i < ring->blocks.size(); i++)
+        {
+            if (playback_running.load(std::memory_order_relaxed) == false)
+            {
+                break;
+            }
+
+            int32_t status = skiq_transmit(card, hdl, ring->blocks[i], NULL);
+            if (status != 0)
+            {
+                /* work() throws on the scheduler thread the next time it is called */
+                d_logger->error( "Error: cyclic playback failed with status {}", status);
+                playback_status = status;
+                playback_running = false;
+                break;
+            }
+        }
+    }
+}
+
+void sidekiq_tx_impl::stop_playback_thread()
+{
+    {
+        std::lock_guard<std::mutex> lock(cyclic_mutex);
+        playback_running = false;
+    }
+    cyclic_cond.notify_all();
+
+    if (playback_thread.joinable())
+    {
+        playback_thread.join();
+        d_logger->info("Info: TX cyclic playback thread stopped");
+    }
+}
+
+/*
+ * begin_burst
+ *
+ * Starts a burst at the current sample.  A length of 0 is a tx_sob burst, it runs until 
+ * its tx_eob sets the length.
+ */
+void sidekiq_tx_impl::begin_burst(uint64_t length)
+{
+    burst_length = length;
+    burst_samples_sent = 0;
+    bursting_cmd = BURSTING_ON;
+
+    /* in continuous mode the stream is already running */
+    if (tx_streaming == false)
+    {
+        if (use_submit_thread == true)
+        {
+            queue_submit(tx_submit_queue::START_STREAM, 0);
+            tx_streaming = true;
+        }
+        else
+        {
+            start_streaming();
+        }
+    }
 }
 
 int sidekiq_tx_impl::handle_tx_burst_tag(tag_t tag) 
@@ -614,14 +1435,7 @@ int sidekiq_tx_impl::handle_tx_burst_tag(tag_t tag)
         d_logger->debug("in handle_tx_burst_tag, tag offset {:d}, cmd {}, length {:d}", 
                 tag.offset, bursting_cmd, pmt::write_string(tag.value));
 
-        burst_length = pmt::to_uint64(tag.value);
-        burst_samples_sent = 0;
-        bursting_cmd = BURSTING_ON;
-
-        if (tx_streaming == false)
-        {
-            start();
-        }
+        begin_burst(pmt::to_uint64(tag.value));
 
         return burst_length;
     }
@@ -642,152 +1456,338 @@ int sidekiq_tx_impl::work(
 	int32_t status{};
 	int32_t samples_written{};
     int32_t ninput_items{};
-    std::vector<tag_t> tags;
 
     (void)(output_items);
 
-    /* get a pointer to the buffer with the samples to be transmitted */
-    auto in = static_cast<const gr_complex *>(input_items[0]);
+    if (submit_status != 0)
+    {
+        d_logger->error( "Error: TX submission failed with status {}", submit_status.load());
+        throw std::runtime_error("Failure: skiq_transmit");
+    }
+
+    /* in cyclic mode the playback thread does the transmitting, the input is consumed and 
+     * dropped so the source runs at its own rate and work() is called again to see failures */
+    if (cyclic_mode == true)
+    {
+        if (playback_status != 0)
+        {
+            throw std::runtime_error("Failure: skiq_transmit");
+        }
+
+        return noutput_items;
+    }
 
-    /* noutput_items should always be larger than tx_buffer_size 
-     * because we did the "forecast" function */
-    if ( noutput_items >= tx_buffer_size)
+    /* noutput_items should always be larger than tx_block_samples 
+     * because we did the "forecast" function, except in low latency mode */
+    if (low_latency == true)
+    {
+        /* a short last block is padded and sent, see below */
+        ninput_items = noutput_items;
+    }
+    else if ( noutput_items >= tx_block_samples)
     {
          /* get the size of the input aligned to our buffer size */
-	     ninput_items = noutput_items - (noutput_items % tx_buffer_size);
+	     ninput_items = noutput_items - (noutput_items % tx_block_samples);
     }
     else
     {
 
-        d_logger->error( "Error: noutput_items {} is smaller than tx_buffer_size {}", 
-                noutput_items, tx_buffer_size);
+        d_logger->error( "Error: noutput_items {} is smaller than tx_block_samples {}", 
+                noutput_items, tx_block_samples);
         throw std::runtime_error("Failure: input items too small");
     }
 
-    pmt_t tx_burst_key{pmt::string_to_symbol(burst_tag_name)};
-
-    /* see if we received the TX_BURST tag, if so process it */
-    get_tags_in_range(tags, 0, nitems_read(0), nitems_read(0) + ninput_items);
-    if (not tags.empty())
+    /* see if we received the burst or tx_time tags.  The burst tags are applied at the sample 
+     * they are on as the loop below reaches them, so a window can hold several bursts.
+     * The keys are interned up front and the tag vectors keep their capacity between calls.
+     * The key filtering get_tags_in_range() builds a temporary vector, so filter here. */
+    _time_tags.clear();
+    _burst_tags.clear();
+    if (bursting_cmd != NO_BURSTING_ENABLED || timed_tx == true)
     {
-        BOOST_FOREACH( const tag_t &tag, tags) 
+        get_tags_in_range(_tags, 0, nitems_read(0), nitems_read(0) + ninput_items);
+        BOOST_FOREACH( const tag_t &tag, _tags) 
         {
-            if (pmt::equal(tag.key, tx_burst_key))
+            /* a work() call that stops short can leave a tag unconsumed, it is only handled once */
+            if (bursting_cmd != NO_BURSTING_ENABLED && 
+                    (pmt::eq(tag.key, TX_SOB_KEY) || pmt::eq(tag.key, TX_EOB_KEY) || 
+                     pmt::eq(tag.key, burst_tag_key)))
             {
-                handle_tx_burst_tag(tag);
+                if (tag.offset >= previous_burst_tag_offset)
+                {
+                    _burst_tags.push_back(tag);
+                }
+            }
+            else if (timed_tx == true && pmt::eq(tag.key, TX_TIME_KEY))
+            {
+                _time_tags.push_back(tag);
             }
         }
+        std::stable_sort(_burst_tags.begin(), _burst_tags.end(), tag_t::offset_compare);
     }
+    uint32_t time_tag_index = 0;
+    uint32_t burst_tag_index = 0;
 
-    if (bursting_cmd == BURSTING_OFF)
-    {
-        // We are not transmitting yet
-        return noutput_items;
-    }
-
-    int32_t samples_to_write = tx_buffer_size;
+    int32_t samples_to_write = tx_block_samples;
+    bool waiting_for_input = false;
 
-    /* if we are streaming in bursts, tx_streaming goes on and off */
-    if (tx_streaming)
+    /* loop until we have handled the samples we have been given */
+    while (samples_written < ninput_items) 
     {
-        /* loop until we have sent the samples we have been given */
-        while (samples_written < ninput_items) 
+        uint64_t position = nitems_read(0) + samples_written;
+        uint64_t next_burst_tag = UINT64_MAX;
+
+        /* start the bursts tagged at this sample, and end the current one at its tx_eob.  
+         * The next start tag bounds what is sent from here */
+        while (burst_tag_index < _burst_tags.size())
         {
-            /* if we are bursting then we need to only send the amount of samples in the burst */
-            if (burst_length != 0)
-            {
-                uint64_t delta = burst_length - burst_samples_sent;
+            const tag_t &tag = _burst_tags[burst_tag_index];
 
-                /* if this number is smaller than our buffer size, we need to send only the delta */
-                if (delta < (uint64_t)tx_buffer_size)
+            if (pmt::eq(tag.key, TX_EOB_KEY))
+            {
+                /* tx_eob is on the last sample of the burst */
+                if (bursting_cmd == BURSTING_ON)
                 {
-                   samples_to_write = delta;
+                    burst_length = burst_samples_sent + (tag.offset + 1 - position);
                 }
-                else 
+            }
+            else if (tag.offset > position)
+            {
+                next_burst_tag = tag.offset;
+                break;
+            }
+            else if (pmt::eq(tag.key, TX_SOB_KEY))
+            {
+                /* the length is not known until the tx_eob, unless a length tag on the 
+                 * same sample already gave it */
+                if (bursting_cmd != BURSTING_ON || burst_samples_sent != 0 || burst_length == 0)
                 {
-                    samples_to_write = tx_buffer_size;
+                    begin_burst(0);
                 }
             }
             else
             {
-                samples_to_write = tx_buffer_size;
+                handle_tx_burst_tag(tag);
             }
 
-            /* convert the samples we have received to be within the dac_scaling values */
-            volk_32f_s32f_multiply_32f(
-                    reinterpret_cast<float *>(&temp_buffer[0]),
-                    reinterpret_cast<const float *>(in),
-                    dac_scaling,
-                    static_cast<unsigned int>(samples_to_write * 2));
-
-            /* convert those samples from float complex to int16 */
-            volk_32fc_convert_16ic(
-                    reinterpret_cast<lv_16sc_t *>(p_tx_blocks[curr_block]->data),
-                    reinterpret_cast<const lv_32fc_t*>(&temp_buffer[0]),
-                    samples_to_write);
-            
-
-            /* transmit the samples */
-            status = skiq_transmit(card, hdl, p_tx_blocks[curr_block], &(p_tx_status[curr_block]));
-
-            /* check to see if the TX queue is full, if so wait for a released buffer */ 
-            if( status == SKIQ_TX_ASYNC_SEND_QUEUE_FULL )
+            previous_burst_tag_offset = tag.offset + 1;
+            burst_tag_index++;
+        }
+
+        int32_t segment = ninput_items - samples_written;
+        if (next_burst_tag - position < (uint64_t)segment)
+        {
+            segment = next_burst_tag - position;
+        }
+
+        /* between bursts the continuous mode keeps the stream fed with zeros, unless the blocks 
+         * are timed, then the card just waits for the next timestamp.  Otherwise the samples 
+         * up to the next burst are not transmitted */
+        bool idle_fill = false;
+        if (bursting_cmd == BURSTING_OFF)
+        {
+            if (continuous_bursts == false || timed_tx == true)
             {
-                // update the in use status since we didn't actually send it yet
-                pthread_mutex_lock( &tx_buf_mutex );
-                p_tx_status[curr_block] = 0;
-                pthread_mutex_unlock( &tx_buf_mutex );
-
-                pthread_mutex_lock( &space_avail_mutex );
-                pthread_cond_wait( &space_avail_cond, &space_avail_mutex );
-                pthread_mutex_unlock( &space_avail_mutex );
+                samples_written += segment;
+                continue;
             }
-            else if ( status != 0 ) 
+            idle_fill = true;
+        }
+
+        /* if we are streaming in bursts, tx_streaming goes on and off */
+        if (tx_streaming == false)
+        {
+            samples_written += segment;
+            continue;
+        }
+
+        /* if we are bursting then we need to only send the amount of samples in the burst */
+        samples_to_write = tx_block_samples;
+        if (burst_length != 0)
+        {
+            uint64_t delta = burst_length - burst_samples_sent;
+
+            /* if this number is smaller than our buffer size, we need to send only the delta */
+            if (delta < (uint64_t)tx_block_samples)
             {
-                d_logger->info("Info: sidekiq transmit failed with error: {}", status);
-                throw std::runtime_error("Failure: skiq_transmit");
-            } 
-            else {
-                samples_written += samples_to_write;
+               samples_to_write = delta;
+            }
+        }
 
-                /* move the pointer */
-                in += samples_to_write;
+        /* the samples before the next burst go out on their own */
+        if (next_burst_tag - position < (uint64_t)samples_to_write)
+        {
+            samples_to_write = next_burst_tag - position;
+        }
+
+        /* not enough input for the block.  Low latency without bursts flushes whatever is there 
+         * as a short block, otherwise wait for the rest of it */
+        if (samples_to_write > ninput_items - samples_written)
+        {
+            if (low_latency == true && bursting_cmd == NO_BURSTING_ENABLED)
+            {
+                samples_to_write = ninput_items - samples_written;
+            }
+            else
+            {
+                waiting_for_input = true;
+                break;
+            }
+        }
+
+        /* in timestamp mode the block is placed by the last tx_time tag at or before its end, 
+         * samples ahead of the tag in the same block go out just before it */
+        if (timed_tx == true)
+        {
+            uint64_t block_offset = position;
+            bool new_time = false;
+
+            while (time_tag_index < _time_tags.size() && 
+                    _time_tags[time_tag_index].offset < block_offset + samples_to_write)
+            {
+                const tag_t &tag = _time_tags[time_tag_index];
 
-                /* move to the next block if we are in async mode, otherwise this is always 1 */
-                curr_block = (curr_block + 1) % num_blocks;
+                next_tx_timestamp = tx_time_to_timestamp(tag.value) - (tag.offset - block_offset);
+                new_time = true;
+                time_tag_index++;
             }
 
-            /* if we are bursting, check to see if we are done */
-            if (burst_length != 0)
+            if (new_time == true)
             {
-                burst_samples_sent += samples_to_write;
-                if (burst_samples_sent >= burst_length) 
+                uint64_t curr_timestamp = 0;
+
+                /* a burst that is already late is dropped here rather than sent late */
+                status = skiq_read_curr_tx_timestamp(card, hdl, &curr_timestamp);
+                if (status != 0)
+                {
+                    d_logger->error( "Error: skiq_read_curr_tx_timestamp failed with status {}", status);
+                    throw std::runtime_error("Failure: skiq_read_curr_tx_timestamp");
+                }
+
+                tx_time_valid = true;
+                dropping_late = (next_tx_timestamp <= curr_timestamp);
+                if (dropping_late == true)
                 {
-                    d_logger->debug("done bursting, sent {}, length {} stop streaming", burst_samples_sent, burst_length);
-                    burst_length = 0;
-                    burst_samples_sent = 0;
-                    stop();
-                    bursting_cmd = BURSTING_OFF;
-                    break;
+                    late_bursts++;
+                    d_logger->debug("late tx_time {}, current timestamp {}", next_tx_timestamp, curr_timestamp);
                 }
             }
+
+            /* no time to send these samples at, consume them without transmitting */
+            if (tx_time_valid == false || dropping_late == true)
+            {
+                samples_written += samples_to_write;
+                next_tx_timestamp += samples_to_write;
+
+                count_burst_samples(samples_to_write);
+                continue;
+            }
+        }
+
+        /* take a free block, waiting for a completion only if all of them are in flight */
+        while (block_held == false)
+        {
+            uint64_t releases = block_pool->releases();
+
+            if (block_pool->acquire(&curr_block) == true)
+            {
+                block_held = true;
+            }
+            else
+            {
+                block_pool->wait_release(releases, std::chrono::microseconds(TX_BLOCK_WAIT_TIMEOUT));
+            }
+        }
+
+        if (idle_fill == true)
+        {
+            /* nothing to send, the input is replaced by silence */
+            memset(p_tx_blocks[curr_block]->data, 0, tx_buffer_size * num_channels * sizeof(uint32_t));
+        }
+        else
+        {
+            /* each channel has its own tx_buffer_size words, so they share the block timestamp */
+            for (uint32_t ch = 0; ch < num_channels; ch++)
+            {
+                fill_tx_channel(
+                        &p_tx_blocks[curr_block]->data[ch * tx_buffer_size * 2],
+                        static_cast<const uint8_t *>(input_items[ch]) + (samples_written * input_item_size),
+                        samples_to_write);
+            }
+        }
+
+        if (timed_tx == true)
+        {
+            skiq_tx_set_block_timestamp(p_tx_blocks[curr_block], next_tx_timestamp);
+        }
+
+        /* transmit the samples, in async mode the callback gets the pool entry as p_user,
+         * libsidekiq only passes the pointer through.  In sync mode the submission thread 
+         * sends it while the next block is filled */
+        uint64_t releases = block_pool->releases();
+        if (use_submit_thread == true)
+        {
+            queue_submit(tx_submit_queue::SEND_BLOCK, curr_block);
+            status = 0;
+        }
+        else
+        {
+            status = skiq_transmit(card, hdl, p_tx_blocks[curr_block], in_async_mode ? 
+                    static_cast<int32_t *>(block_pool->user_context(curr_block)) : NULL);
         }
 
-        /* Determine if the time has elapsed and display any underruns we have received */
-        if (nitems_read(0) - last_status_update_sample > status_update_rate_in_samples) 
+        /* check to see if the TX queue is full, if so keep the block and wait for a completion.
+         * Nothing was sent, so the burst is not counted either */ 
+        if( status == SKIQ_TX_ASYNC_SEND_QUEUE_FULL )
+        {
+            block_pool->wait_release(releases, std::chrono::microseconds(TX_BLOCK_WAIT_TIMEOUT));
+            continue;
+        }
+        else if ( status != 0 ) 
         {
-            update_tx_error_count();
-            last_status_update_sample = nitems_read(0);
+            d_logger->info("Info: sidekiq transmit failed with error: {}", status);
+            throw std::runtime_error("Failure: skiq_transmit");
+        } 
+        else {
+            samples_written += samples_to_write;
+
+            /* the block now belongs to libsidekiq until the callback returns it, or to the
+             * submission thread until it is sent.  A sync transmit is done with it already */
+            block_held = false;
+            if (in_async_mode == false && use_submit_thread == false)
+            {
+                block_pool->release(curr_block);
+            }
 
+            /* the next block of the burst follows straight on */
+            next_tx_timestamp += samples_to_write;
+        }
 
-            d_logger->debug("noutput_items {}, tx_buffer_size {}, sample_written {}", 
-                    noutput_items, tx_buffer_size, samples_written);
+        /* if we are bursting, see if the burst is done, the loop carries on with the next one */
+        if (idle_fill == false)
+        {
+            count_burst_samples(samples_to_write);
         }
     }
 
+    /* a short work() asks the scheduler for more input than it had before calling again */
+    input_items_wanted = (waiting_for_input == true) ? (ninput_items - samples_written + 1) : 0;
+
+    /* Determine if the time has elapsed and display any underruns we have received */
+    if (tx_streaming == true && 
+            nitems_read(0) - last_status_update_sample > status_update_rate_in_samples) 
+    {
+        update_tx_error_count();
+        last_status_update_sample = nitems_read(0);
+
+
+        d_logger->debug("noutput_items {}, tx_buffer_size {}, sample_written {}", 
+                noutput_items, tx_buffer_size, samples_written);
+    }
+
     /* if we are bursting and we have not written anything we need to lie and say we did.  Otherwise 
      * the flowchart stops sending samples */
-    if (samples_written == 0)
+    if (samples_written == 0 && waiting_for_input == false)
     {
         samples_written = ninput_items;
     }
@@ -11,15 +11,56 @@
 #include <pmt/pmt.h>
 #include <gnuradio/sidekiq/sidekiq_tx.h>
 #include <sidekiq_api.h>
+#include <volk/volk.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "tx_block_pool.h"
+#include "tx_submit_queue.h"
+#include "card_manager.h"
 
-#define NUM_BLOCKS              20    // number of tx blocks to allocate and use.
+#define NUM_BLOCKS              20    // default number of tx blocks to allocate and use.
+
+#define TX_BLOCK_WAIT_TIMEOUT   100000 // us, longest wait for a block before checking again
 
 #define CAL_ON                  1     // run_cal parameter if a manual calibration is requested
 
+#define NO_HANDLE               100   // handle2 value when only one channel is used
+#define MAX_TX_CHANNELS         2     // A1 and A2, or B1 and B2, in dual channel mode
+
+#define TAG_RESERVE_COUNT       64    // initial tag capacity so work() does not grow it while streaming
+
+/* TX data flow modes */
+#define TX_TIMESTAMP_MODE_OFF   0     // blocks are sent as soon as they are queued
+#define TX_TIMESTAMP_MODE_ON    1     // blocks are sent at their timestamp, late ones are dropped
+
 #define BURSTING_OFF            0          
 #define BURSTING_ON             1
 #define NO_BURSTING_ENABLED     2
 
+/* what happens to the stream between bursts */
+#define BURST_MODE_START_STOP   0     // start streaming for each burst, stop at its end
+#define BURST_MODE_CONTINUOUS   1     // keep streaming, send zeros (or nothing if timed) in between
+
+/* cyclic playback */
+#define CYCLIC_MODE_OFF         0     // transmit the input stream
+#define CYCLIC_MODE_ON          1     // repeat a loaded waveform, the input is not read
+#define CYCLIC_MAX_BLOCKS       4096  // most blocks a waveform is repeated into to end on a block boundary
+
+/* input sample types */
+#define INPUT_FORMAT_FC32       0     // gr_complex scaled to +/- 1.0
+#define INPUT_FORMAT_SC16       1     // I/Q shorts already in the DAC range, copied as is
+#define INPUT_FORMAT_SC16_FULL  2     // full scale I/Q shorts, shifted down to the DAC range
+
+#define IQ_SHORT_COUNT          2     // shorts in one sc16 sample
+
+/* how work() waits for input */
+#define LATENCY_MODE_FULL_BLOCKS    0     // only whole blocks are sent, the default
+#define LATENCY_MODE_LOW            1     // short blocks are zero padded and flushed
+
 using pmt::pmt_t;
 
 namespace gr {
@@ -27,6 +68,8 @@ namespace sidekiq {
 
     static const bool SIDEKIQ_IQ_PACK_MODE_UNPACKED{false};
 
+    static const bool SIDEKIQ_IQ_PACK_MODE_PACKED{true};
+
     static const double STATUS_UPDATE_RATE_SECONDS{2.0};
 
     /* message and tag keys */
@@ -40,6 +83,16 @@ namespace sidekiq {
 
     static const pmt_t ATTENUATION_KEY{pmt::string_to_symbol("attenuation")};
 
+    static const pmt_t TIME_KEY{pmt::string_to_symbol("time")};
+
+    static const pmt_t TX_TIME_KEY{pmt::string_to_symbol("tx_time")};
+
+    static const pmt_t WAVEFORM_MESSAGE_PORT{pmt::string_to_symbol("waveform")};
+
+    static const pmt_t TX_SOB_KEY{pmt::string_to_symbol("tx_sob")};
+
+    static const pmt_t TX_EOB_KEY{pmt::string_to_symbol("tx_eob")};
+
 class sidekiq_tx_impl : public sidekiq_tx
 {
 public:
@@ -53,7 +106,16 @@ public:
                     std::string burst_tag,
                     int threads,
                     int buffer_size,
-                    int cal_mode);
+                    int cal_mode,
+                    int packed_mode,
+                    int queue_depth,
+                    int timestamp_mode,
+                    int burst_mode,
+                    int latency_mode,
+                    int handle2,
+                    int input_format,
+                    int cyclic_mode,
+                    std::string cyclic_file);
 
 
 
@@ -75,6 +137,8 @@ public:
 
     void forecast(int noutput_items, gr_vector_int &ninput_items_required) override;
 
+    bool check_topology(int ninputs, int noutputs) override;
+
     void set_tx_sample_rate(double value) override;
 
     void set_tx_attenuation(double value) override;
@@ -88,54 +152,143 @@ public:
     /* User sends 1 when it wants to run calibration */
     void run_tx_cal(int value) override;
 
+    void set_cyclic_waveform(const std::vector<gr_complex> &waveform) override;
+
+    void handle_waveform_message(pmt_t message);
+
 
 
 private:
     /* method prototypes */
+    void release_card();
     int handle_tx_burst_tag(tag_t tag);
+    void begin_burst(uint64_t length);
+    bool count_burst_samples(int32_t samples);
+    void pad_block_tail(int16_t *p_data, int32_t samples);
+    void fill_tx_channel(int16_t *p_data, const void *p_in, int32_t samples);
+    static size_t input_item_size_for(int input_format);
+
+    /* cyclic playback */
+    struct cyclic_ring;
+    std::shared_ptr<cyclic_ring> build_cyclic_ring(const std::vector<gr_complex> &waveform);
+    void load_cyclic_file(const std::string &filename);
+    void playback_loop();
+    void stop_playback_thread();
+
+    /* stream control and the sync mode submission thread */
+    void apply_radio_config();
+    void write_rate_and_bandwidth(uint32_t rate, uint32_t bw);
+    void start_streaming();
+    void stop_streaming();
+    void queue_submit(uint32_t flags, uint32_t block);
+    void submit_loop();
+    void stop_submit_thread();
     void update_tx_error_count();
+    uint64_t tx_time_to_timestamp(const pmt_t &value);
     double get_double_from_pmt_dict(pmt_t dict, pmt_t key, pmt_t not_found ); 
 
     /* passed in parameters */
     uint8_t card{};
     skiq_tx_hdl_t hdl{};
+    skiq_tx_hdl_t hdl2{};            /* second channel in dual channel mode */
+    uint32_t num_channels{};         /* inputs, each block holds this many channels */
     uint32_t sample_rate{};
     uint32_t bandwidth{};
     uint64_t frequency{};
     uint32_t attenuation{};
     std::string burst_tag_name{};
+    pmt_t burst_tag_key{};
     skiq_tx_quadcal_mode_t calibration_mode{};
+    bool packed_mode{};
 
     /* flags */
     bool libsidekiq_init{};
+    bool dual_chan_held{};           /* the card is held in dual channel mode for this block */
     bool tx_streaming{};
     bool tx_second{};
+    bool radio_configured{};         /* false while the settings are only staged */
+
+    /* settings last written to the handles, unchanged settings are not written again */
+    struct radio_shadow {
+        bool rate_valid{};
+        uint32_t sample_rate{};
+        uint32_t bandwidth{};
+        uint64_t frequency{};                       /* 0 until written */
+        int64_t attenuation[MAX_TX_CHANNELS]{-1, -1};  /* -1 until written, per channel */
+        int32_t cal_mode[MAX_TX_CHANNELS]{-1, -1};
+    };
+    radio_shadow written;
 
     /* sync/async parameters */
     bool in_async_mode{};
     skiq_tx_block_t **p_tx_blocks{};
     skiq_tx_block_t *sync_tx_block{};
-    int32_t *p_tx_status{};
     uint32_t num_blocks{};
+    std::unique_ptr<tx_block_pool> block_pool;    /* blocks not in flight */
+    bool block_held{};                            /* curr_block was acquired but not yet sent */
+
+    /* in sync mode a submission thread does the blocking skiq_transmit() calls, so work() 
+     * fills the next block while the last one is sent.  Stream starts and stops for bursts 
+     * go through the same queue so they happen in order with the blocks */
+    bool use_submit_thread{};
+    std::unique_ptr<tx_submit_queue> submit_queue;
+    std::thread submit_thread;
+    std::atomic<bool> submit_running{};
+    std::atomic<int32_t> submit_status{};
+    std::atomic<bool> stream_running{};           /* the card is streaming, tx_streaming is what work() asked for */
 
 
     /* work() parameters */
     double dac_scaling{};
+    bool input_sc16{};             /* samples are already int16 I/Q */
+    uint32_t input_shift{};        /* bits a full scale sc16 sample is shifted down by */
+    size_t input_item_size{};
     size_t last_status_update_sample{};
     size_t status_update_rate_in_samples{};
     uint32_t last_num_tx_errors{};
     uint32_t curr_block{};
-    std::vector<gr_complex> temp_buffer;
-    int32_t tx_buffer_size{};
+    int32_t tx_buffer_size{};      /* words in a TX block */
+    int32_t tx_block_samples{};    /* samples in a TX block, more than words when packed */
+    bool low_latency{};            /* flush short blocks instead of waiting for a full one */
+    int input_items_wanted{};      /* more than work() had when it stopped short, 0 if it did not */
+    std::vector<lv_16sc_t> pack_buffer;
     uint64_t timestamp{};
 
     /* bursting */
     uint32_t bursting_cmd{};
-    std::vector<tag_t> _tags;    
+    bool continuous_bursts{};
+    std::vector<tag_t> _tags;    /* reused by work() so it does not allocate once streaming */
+    std::vector<tag_t> _burst_tags;    /* length, tx_sob and tx_eob tags in offset order */
     uint64_t burst_length{};
     uint64_t burst_samples_sent{};
-    uint64_t previous_burst_tag_offset{};
-
+    uint64_t previous_burst_tag_offset{};    /* burst tags before this were already handled */
+
+    /* timed TX, each block gets next_tx_timestamp which the tx_time tags anchor */
+    bool timed_tx{};
+    bool tx_time_valid{};          /* a tx_time tag has been seen */
+    bool dropping_late{};          /* the current burst was late, drop it up to the next tx_time */
+    uint64_t next_tx_timestamp{};
+    uint64_t late_bursts{};
+    uint64_t last_late_bursts{};
+    uint32_t last_num_late{};
+    std::vector<tag_t> _time_tags;
+
+
+    /* cyclic playback, the waveform is converted once into its own blocks which the 
+     * playback thread transmits over and over.  A new waveform replaces the ring at the end 
+     * of a cycle */
+    struct cyclic_ring {
+        std::vector<skiq_tx_block_t *> blocks;
+        uint64_t samples{};
+        ~cyclic_ring();
+    };
+    bool cyclic_mode{};
+    std::shared_ptr<cyclic_ring> cyclic_blocks;    /* guarded by cyclic_mutex */
+    std::mutex cyclic_mutex;
+    std::condition_variable cyclic_cond;           /* a waveform was loaded or playback stopped */
+    std::thread playback_thread;
+    std::atomic<bool> playback_running{};
+    std::atomic<int32_t> playback_status{};
 
     /* displaying info in work() needs to stop after a few calls */
     uint32_t debug_ctr{};
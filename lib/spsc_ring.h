@@ -0,0 +1,156 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_SIDEKIQ_SPSC_RING_H
+#define INCLUDED_SIDEKIQ_SPSC_RING_H
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace gr {
+namespace sidekiq {
+
+/*
+ * spsc_ring
+ *
+ * Bounded single producer / single consumer ring of T, the base of the RX block rings, the
+ * TX submission queue and the timed command queue.  Every slot is allocated up front, so
+ * nothing allocates once it runs, and push and pop are lock free.
+ *
+ * The producer fills the slot from back() and publishes it with push(), the consumer reads
+ * the slot from front() and hands it back with pop().  A slot stays valid for its side until
+ * then.  head and tail count without wrapping, the size is rounded up to a power of two so
+ * they can be masked, and head - tail is the fill level even after they overflow.
+ *
+ * head is only written by the producer and tail only by the consumer.  Each side publishes
+ * its index with a release store and reads the other one with an acquire load: the consumer
+ * then sees the slot contents written before push(), and the producer does not reuse a slot
+ * before the consumer is done with it.
+ */
+template <typename T>
+class spsc_ring
+{
+public:
+    explicit spsc_ring(uint32_t num_items)
+    {
+        uint32_t size = 1;
+
+        if (num_items == 0)
+        {
+            throw std::invalid_argument("spsc_ring: num_items must be > 0");
+        }
+
+        /* round up to a power of two so the indexes can be masked */
+        while (size < num_items)
+        {
+            size <<= 1;
+        }
+
+        mask = size - 1;
+        items.resize(size);
+    }
+
+    /* producer side, the free slot to fill or NULL if the ring is full */
+    T *back()
+    {
+        uint32_t curr_head = head.load(std::memory_order_relaxed);
+
+        if ((curr_head - tail.load(std::memory_order_acquire)) > mask)
+        {
+            return NULL;
+        }
+
+        return &items[curr_head & mask];
+    }
+
+    /* producer side, publishes the slot from back() */
+    void push()
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /* producer side, returns false if the ring is full */
+    bool push(const T &item)
+    {
+        T *p_item = back();
+
+        if (p_item == NULL)
+        {
+            return false;
+        }
+
+        *p_item = item;
+        push();
+
+        return true;
+    }
+
+    /* consumer side, the oldest slot or NULL if the ring is empty */
+    T *front()
+    {
+        uint32_t curr_tail = tail.load(std::memory_order_relaxed);
+
+        if (curr_tail == head.load(std::memory_order_acquire))
+        {
+            return NULL;
+        }
+
+        return &items[curr_tail & mask];
+    }
+
+    const T *front() const { return const_cast<spsc_ring *>(this)->front(); }
+
+    /* consumer side, hands the slot from front() back to the producer */
+    void pop()
+    {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /* consumer side, returns false if the ring is empty */
+    bool pop(T *p_item)
+    {
+        const T *p_front = front();
+
+        if (p_front == NULL)
+        {
+            return false;
+        }
+
+        *p_item = *p_front;
+        pop();
+
+        return true;
+    }
+
+    bool empty() const { return tail.load(std::memory_order_relaxed) == head.load(std::memory_order_acquire); }
+    uint32_t capacity() const { return mask + 1; }
+
+    /* the i-th slot, to set up per slot state before either side runs.  back() and front()
+     * start at slot 0 after a reset() */
+    T &slot(uint32_t i) { return items[i]; }
+
+    /* only call when neither side is running */
+    void reset()
+    {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    uint32_t mask{};
+    std::vector<T> items;
+
+    alignas(64) std::atomic<uint32_t> head{};
+    alignas(64) std::atomic<uint32_t> tail{};
+};
+
+} // namespace sidekiq
+} // namespace gr
+
+#endif /* INCLUDED_SIDEKIQ_SPSC_RING_H */
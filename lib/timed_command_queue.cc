@@ -0,0 +1,28 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "timed_command_queue.h"
+
+namespace gr {
+namespace sidekiq {
+
+bool timed_command_queue::front(command *p_command) const
+{
+    const command *p_front = commands.front();
+
+    if (p_front == NULL)
+    {
+        return false;
+    }
+
+    *p_command = *p_front;
+
+    return true;
+}
+
+} // namespace sidekiq
+} // namespace gr
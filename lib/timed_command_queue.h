@@ -0,0 +1,59 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_SIDEKIQ_TIMED_COMMAND_QUEUE_H
+#define INCLUDED_SIDEKIQ_TIMED_COMMAND_QUEUE_H
+
+#include "spsc_ring.h"
+#include <cstdint>
+
+namespace gr {
+namespace sidekiq {
+
+/*
+ * timed_command_queue
+ *
+ * Single producer / single consumer queue of tuning commands from the control message
+ * handler to work().  work() applies the command at the front once the card reaches its
+ * rf_timestamp, so the commands are applied in the order they were sent.
+ *
+ * An spsc_ring, push(), front() and pop() are lock free.
+ */
+class timed_command_queue
+{
+public:
+    /* what a command changes */
+    static const uint32_t SET_FREQUENCY = 0x1;   // LO frequency
+    static const uint32_t SET_GAIN      = 0x2;   // gain index
+
+    struct command {
+        uint64_t timestamp;       // rf_timestamp to apply at, 0 applies at the next work()
+        uint32_t flags;
+        uint64_t frequency;
+        int32_t gain_index;
+    };
+
+    explicit timed_command_queue(uint32_t num_commands) : commands(num_commands) {}
+
+    /* producer side, returns false if the queue is full */
+    bool push(const command &c) { return commands.push(c); }
+
+    /* consumer side, front() returns false if the queue is empty */
+    bool front(command *p_command) const;
+    void pop() { commands.pop(); }
+
+    /* only call when neither side is running */
+    void reset() { commands.reset(); }
+
+private:
+    spsc_ring<command> commands;
+};
+
+} // namespace sidekiq
+} // namespace gr
+
+#endif /* INCLUDED_SIDEKIQ_TIMED_COMMAND_QUEUE_H */
@@ -0,0 +1,120 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "tx_block_pool.h"
+#include <stdexcept>
+
+namespace gr {
+namespace sidekiq {
+
+/*
+ * The free list is a bounded multi producer / multi consumer queue of block indexes.  Each
+ * cell carries a sequence number that says whether it is ready to be written or read for
+ * the current lap, so producers and the consumer never need a lock.
+ */
+tx_block_pool::tx_block_pool(uint32_t num_blocks) : num_blocks(num_blocks)
+{
+    uint32_t size = 1;
+
+    if (num_blocks == 0)
+    {
+        throw std::invalid_argument("tx_block_pool: num_blocks must be > 0");
+    }
+
+    /* round up to a power of two so the positions can be masked */
+    while (size < num_blocks)
+    {
+        size <<= 1;
+    }
+    mask = size - 1;
+
+    cells.reset(new cell[size]);
+    for (uint32_t i = 0; i < size; i++)
+    {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    entries.resize(num_blocks);
+    for (uint32_t i = 0; i < num_blocks; i++)
+    {
+        entries[i].pool = this;
+        entries[i].index = i;
+        release(i);
+    }
+}
+
+bool tx_block_pool::acquire(uint32_t *p_index)
+{
+    uint32_t pos = dequeue_pos.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+        cell *p_cell = &cells[pos & mask];
+        uint32_t seq = p_cell->sequence.load(std::memory_order_acquire);
+        int32_t dif = static_cast<int32_t>(seq - (pos + 1));
+
+        if (dif == 0)
+        {
+            if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                *p_index = p_cell->index;
+                p_cell->sequence.store(pos + mask + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (dif < 0)
+        {
+            /* every block is in flight */
+            return false;
+        }
+        else
+        {
+            pos = dequeue_pos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void tx_block_pool::release(uint32_t index)
+{
+    uint32_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    cell *p_cell{};
+
+    for (;;)
+    {
+        p_cell = &cells[pos & mask];
+        uint32_t seq = p_cell->sequence.load(std::memory_order_acquire);
+        int32_t dif = static_cast<int32_t>(seq - pos);
+
+        /* there are never more releases than blocks, so the queue can not be full */
+        if (dif == 0)
+        {
+            if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else
+        {
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    p_cell->index = index;
+    p_cell->sequence.store(pos + 1, std::memory_order_release);
+
+    released.signal();
+}
+
+void tx_block_pool::complete(void *p_user)
+{
+    entry *p_entry = static_cast<entry *>(p_user);
+
+    p_entry->pool->release(p_entry->index);
+}
+
+} // namespace sidekiq
+} // namespace gr
@@ -0,0 +1,81 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_SIDEKIQ_TX_BLOCK_POOL_H
+#define INCLUDED_SIDEKIQ_TX_BLOCK_POOL_H
+
+#include "change_waiter.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace gr {
+namespace sidekiq {
+
+/*
+ * tx_block_pool
+ *
+ * Free list of the TX block indexes owned by one sidekiq_tx instance.  work() acquires a
+ * block, fills it and hands it to skiq_transmit() with user_context() as p_user.  The
+ * libsidekiq completion callback passes that p_user to complete(), which puts the block back.
+ *
+ * acquire() and release() are lock free, the callback can run on any of the libsidekiq
+ * TX threads.  work() waits for a release through a change_waiter when every block is in
+ * flight.
+ */
+class tx_block_pool
+{
+public:
+    explicit tx_block_pool(uint32_t num_blocks);
+
+    /* consumer side, returns false if every block is in flight */
+    bool acquire(uint32_t *p_index);
+
+    /* any thread, returns the block to the pool and wakes a waiting consumer */
+    void release(uint32_t index);
+
+    /* the p_user context for a block and the callback side of it */
+    void *user_context(uint32_t index) { return &entries[index]; }
+    static void complete(void *p_user);
+
+    /* number of release() calls so far, pass it to wait_release() */
+    uint64_t releases() const { return released.changes(); }
+
+    /* wait until a block is released after releases() returned since, false on timeout */
+    bool wait_release(uint64_t since, std::chrono::microseconds timeout) { return released.wait(since, timeout); }
+
+    uint32_t size() const { return num_blocks; }
+
+private:
+    struct cell {
+        std::atomic<uint32_t> sequence;
+        uint32_t index;
+    };
+
+    struct entry {
+        tx_block_pool *pool;
+        uint32_t index;
+    };
+
+    uint32_t num_blocks{};
+    uint32_t mask{};
+    std::unique_ptr<cell[]> cells;
+    std::vector<entry> entries;
+
+    alignas(64) std::atomic<uint32_t> enqueue_pos{};
+    alignas(64) std::atomic<uint32_t> dequeue_pos{};
+
+    /* wakeup of a consumer waiting for a block */
+    change_waiter released;
+};
+
+} // namespace sidekiq
+} // namespace gr
+
+#endif /* INCLUDED_SIDEKIQ_TX_BLOCK_POOL_H */
@@ -0,0 +1,38 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "tx_submit_queue.h"
+
+namespace gr {
+namespace sidekiq {
+
+bool tx_submit_queue::push(const entry &e)
+{
+    if (entries.push(e) == false)
+    {
+        return false;
+    }
+
+    changed.signal();
+
+    return true;
+}
+
+bool tx_submit_queue::pop(entry *p_entry)
+{
+    if (entries.pop(p_entry) == false)
+    {
+        return false;
+    }
+
+    changed.signal();
+
+    return true;
+}
+
+} // namespace sidekiq
+} // namespace gr
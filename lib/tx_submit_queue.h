@@ -0,0 +1,67 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 epiq.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_SIDEKIQ_TX_SUBMIT_QUEUE_H
+#define INCLUDED_SIDEKIQ_TX_SUBMIT_QUEUE_H
+
+#include "change_waiter.h"
+#include "spsc_ring.h"
+#include <chrono>
+#include <cstdint>
+
+namespace gr {
+namespace sidekiq {
+
+/*
+ * tx_submit_queue
+ *
+ * Single producer / single consumer queue from work() to the TX submission thread.  work()
+ * pushes each filled block, plus the stream starts and stops of start/stop bursting, so the
+ * thread does them in the same order the samples were given.
+ *
+ * An spsc_ring, push() and pop() are lock free.  Either side can wait for the other to make
+ * a change through a change_waiter.
+ */
+class tx_submit_queue
+{
+public:
+    /* what an entry asks the submission thread to do */
+    static const uint32_t START_STREAM = 0x1;    // skiq_start_tx_streaming()
+    static const uint32_t SEND_BLOCK   = 0x2;    // skiq_transmit() the block, then free it
+    static const uint32_t STOP_STREAM  = 0x4;    // skiq_stop_tx_streaming()
+
+    struct entry {
+        uint32_t flags;
+        uint32_t block;
+    };
+
+    explicit tx_submit_queue(uint32_t num_entries) : entries(num_entries) {}
+
+    /* producer side, returns false if the queue is full */
+    bool push(const entry &e);
+
+    /* consumer side, returns false if the queue is empty */
+    bool pop(entry *p_entry);
+
+    /* number of pushes and pops so far, pass it to wait_change() */
+    uint64_t changes() const { return changed.changes(); }
+
+    /* wait until the other side pushes or pops after changes() returned since, false on timeout */
+    bool wait_change(uint64_t since, std::chrono::microseconds timeout) { return changed.wait(since, timeout); }
+
+    /* only call when neither side is running */
+    void reset() { entries.reset(); }
+
+private:
+    spsc_ring<entry> entries;
+    change_waiter changed;
+};
+
+} // namespace sidekiq
+} // namespace gr
+
+#endif /* INCLUDED_SIDEKIQ_TX_SUBMIT_QUEUE_H */
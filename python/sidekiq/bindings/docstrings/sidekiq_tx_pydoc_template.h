@@ -45,4 +45,7 @@
 
  static const char *__doc_gr_sidekiq_sidekiq_tx_run_tx_cal = R"doc()doc";
 
+
+ static const char *__doc_gr_sidekiq_sidekiq_tx_set_cyclic_waveform = R"doc()doc";
+
   
@@ -14,7 +14,7 @@
 /* BINDTOOL_GEN_AUTOMATIC(0)                                                       */
 /* BINDTOOL_USE_PYGCCXML(0)                                                        */
 /* BINDTOOL_HEADER_FILE(sidekiq_rx.h)                                        */
-/* BINDTOOL_HEADER_FILE_HASH(c82ab397b04e68a633a84776a624894e)                     */
+/* BINDTOOL_HEADER_FILE_HASH(446dfc9bd1d06171bf9956a6d86989b6)                     */
 /***********************************************************************************/
 
 #include <pybind11/complex.h>
@@ -50,6 +50,15 @@ void bind_sidekiq_rx(py::module& m)
            py::arg("pps_source"),
            py::arg("cal_mode"),
            py::arg("cal_type"),
+           py::arg("capture_blocks") = 0,
+           py::arg("output_format") = 0,
+           py::arg("rx_strategy") = 1,
+           py::arg("stream_mode") = 0,
+           py::arg("packed_mode") = 0,
+           py::arg("overrun_mode") = 0,
+           py::arg("port3_handle") = 100,
+           py::arg("port4_handle") = 100,
+           py::arg("extra_cards") = std::vector<int>(),
            D(sidekiq_rx,make)
         )
         
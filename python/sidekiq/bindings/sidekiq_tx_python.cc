@@ -14,7 +14,7 @@
 /* BINDTOOL_GEN_AUTOMATIC(0)                                                       */
 /* BINDTOOL_USE_PYGCCXML(0)                                                        */
 /* BINDTOOL_HEADER_FILE(sidekiq_tx.h)                                        */
-/* BINDTOOL_HEADER_FILE_HASH(ccaa9bc778fd68f62ae93e8606eca355)                     */
+/* BINDTOOL_HEADER_FILE_HASH(25425504f00fd9a227fb39b939648b33)                     */
 /***********************************************************************************/
 
 #include <pybind11/complex.h>
@@ -47,6 +47,15 @@ void bind_sidekiq_tx(py::module& m)
            py::arg("threads"),
            py::arg("buffer_size"),
            py::arg("cal_mode"),
+           py::arg("packed_mode") = 0,
+           py::arg("queue_depth") = 20,
+           py::arg("timestamp_mode") = 0,
+           py::arg("burst_mode") = 0,
+           py::arg("latency_mode") = 0,
+           py::arg("handle2") = 100,
+           py::arg("input_format") = 0,
+           py::arg("cyclic_mode") = 0,
+           py::arg("cyclic_file") = "",
            D(sidekiq_tx,make)
         )
         
@@ -95,6 +104,13 @@ void bind_sidekiq_tx(py::module& m)
             D(sidekiq_tx,run_tx_cal)
         )
 
+
+        
+        .def("set_cyclic_waveform",&sidekiq_tx::set_cyclic_waveform,       
+            py::arg("waveform"),
+            D(sidekiq_tx,set_cyclic_waveform)
+        )
+
         ;
 
 